@@ -0,0 +1,227 @@
+#ifndef BINARYJOB_H_
+#define BINARYJOB_H_
+
+#include "GCodeParser.h"
+#include "Coordinate.h"
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Packed binary command stream, sent after an "M90" line in place of G-code text.
+ *
+ * Every record is an opcode byte followed by its fields, each a LEB128 varint (7 bits per byte, low bits first).
+ * G1 coordinates are micrometre deltas from the previous G1 of the job, zigzag-encoded so small negative moves stay short.
+ * A typical plotter move is 3-5 bytes instead of about 20 characters, and the decoder does no text parsing at all.
+ * Opcode End returns the receiver to G-code text. CR and LF are never opcodes and are skipped between records,
+ * so it doesn't matter how the M90 line was terminated.
+ */
+namespace BinaryJob {
+enum Opcode : uint8_t {
+    End = 0x00,
+    M1 = 0x01,          // pen position
+    M2 = 0x02,          // pen up, pen down
+    M4 = 0x04,          // laser power
+    M5 = 0x05,          // a step, b step, height, width, speed
+    M10 = 0x10,
+    M11 = 0x11,
+    G28 = 0x1C,
+    G1Absolute = 0x80,  // zigzag dx, zigzag dy
+    G1Relative = 0x81,  // zigzag dx, zigzag dy
+};
+
+[[nodiscard]] constexpr uint8_t fieldCount(Opcode const opcode) noexcept {
+    switch (opcode) {
+    case M1: case M4: return 1;
+    case M2: case G1Absolute: case G1Relative: return 2;
+    case M5: return 5;
+    default: return 0;
+    }
+}
+
+/* Bit i is set if field i goes to the callback as a uint8_t. Past 255 it's rejected, as GCodeParser rejects M1 300 */
+[[nodiscard]] constexpr uint8_t byteFields(Opcode const opcode) noexcept {
+    switch (opcode) {
+    case M1: case M4: return 0b00001;
+    case M2: return 0b00011;
+    case M5: return 0b10011;
+    default: return 0;
+    }
+}
+
+[[nodiscard]] constexpr bool isOpcode(uint8_t const byte) noexcept {
+    switch (byte) {
+    case End: case M1: case M2: case M4: case M5: case M10: case M11: case G28: case G1Absolute: case G1Relative: return true;
+    default: return false;
+    }
+}
+
+[[nodiscard]] constexpr uint32_t zigzag(int32_t const value) noexcept {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+[[nodiscard]] constexpr int32_t unzigzag(uint32_t const value) noexcept {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+/* A GCodeParser handler that writes each callback as a binary record. sink is a callable taking one uint8_t */
+template <typename Sink>
+class Encoder {
+public:
+    Encoder(Sink sink) : sink{ sink } {}
+
+    void onM1Received(uint8_t pen_position) { record(M1, pen_position); }
+    void onM2Received(uint8_t pen_up, uint8_t pen_down) { record(M2, pen_up, pen_down); }
+    void onM4Received(uint8_t laser_power) { record(M4, laser_power); }
+    void onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) { record(M5, a_step, b_step, height, width, speed); }
+    void onM10Received() { record(M10); }
+    void onM11Received() { record(M11); }
+    void onG28Received() { record(G28); }
+
+    void onG1Received(Coordinate x, Coordinate y, uint8_t relative) {
+        record(relative ? G1Relative : G1Absolute, zigzag((x - last_x).micrometres()), zigzag((y - last_y).micrometres()));
+        last_x = x;
+        last_y = y;
+    }
+
+    void end() { record(End); }
+
+private:
+    Sink sink;
+    Coordinate last_x, last_y;
+
+    template <typename... Fields>
+    void record(Opcode const opcode, Fields const... fields) {
+        sink(opcode);
+        (varint(fields), ...);
+    }
+
+    void varint(uint32_t value) {
+        while (value >= 0x80) {
+            sink(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        sink(static_cast<uint8_t>(value));
+    }
+};
+
+/* Decodes a binary job one byte at a time and calls the same callbacks as GCodeParser. Plotter is bound the same way too */
+template <typename Plotter>
+class Decoder {
+public:
+    Decoder(Plotter* plotter) : plotter{ plotter } {}
+
+    /* Call at the start of every job, the coordinate deltas restart from zero */
+    void reset() noexcept {
+        opcode = End;
+        field = remaining = 0;
+        shift = 0;
+        last_x = last_y = Coordinate{};
+    }
+
+    /* Returns false once the job has ended (End opcode or a corrupt stream) and the caller should go back to text */
+    [[nodiscard]] bool feed(uint8_t const byte) noexcept {
+        if (remaining == 0 && field == 0) {
+            if (byte == '\r' || byte == '\n')
+                return true;
+
+            if (!isOpcode(byte))
+                return corrupt();
+
+            opcode = static_cast<Opcode>(byte);
+            remaining = fieldCount(opcode);
+            values[0] = 0;
+            shift = 0;
+        } else {
+            if (shift > 28 || (shift == 28 && (byte & 0x70) != 0)) // More than 32 bits can't be a 32-bit varint
+                return corrupt();
+
+            values[field] |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+
+            if (byte & 0x80)
+                return true;
+
+            ++field;
+            --remaining;
+            shift = 0;
+            if (remaining > 0)
+                values[field] = 0;
+        }
+
+        if (remaining > 0)
+            return true;
+
+        field = 0;
+        return dispatch();
+    }
+
+    [[nodiscard]] bool feed(uint8_t const* buffer, size_t const length) noexcept {
+        for (size_t i = 0; i < length; ++i)
+            if (!feed(buffer[i]))
+                return false;
+        return true;
+    }
+
+private:
+    Plotter* plotter;
+    Opcode opcode{ End };
+    uint8_t field{ 0 }, remaining{ 0 }, shift{ 0 };
+    uint32_t values[5]{ 0 };
+    Coordinate last_x, last_y;
+
+    /* Reported the way GCodeParser reports a malformed line, then the rest of the job is dropped */
+    [[nodiscard]] bool corrupt() noexcept {
+        if (plotter != nullptr)
+            plotter->onError(GCodeScanner::kMalformedCode);
+        reset();
+        return false;
+    }
+
+    [[nodiscard]] bool dispatch() noexcept {
+        for (uint8_t i = 0; i < fieldCount(opcode); ++i)
+            if ((byteFields(opcode) >> i & 1) != 0 && values[i] > UINT8_MAX)
+                return corrupt();
+
+        if (opcode == G1Absolute || opcode == G1Relative) {
+            last_x += Coordinate::fromMicrometres(unzigzag(values[0]));
+            last_y += Coordinate::fromMicrometres(unzigzag(values[1]));
+        }
+
+        if (plotter == nullptr)
+            return opcode != End;
+
+        switch (opcode) {
+        case End:
+            return false;
+        case M1:
+            plotter->onM1Received(values[0]);
+            break;
+        case M2:
+            plotter->onM2Received(values[0], values[1]);
+            break;
+        case M4:
+            plotter->onM4Received(values[0]);
+            break;
+        case M5:
+            plotter->onM5Received(values[0], values[1], values[2], values[3], values[4]);
+            break;
+        case M10:
+            plotter->onM10Received();
+            break;
+        case M11:
+            plotter->onM11Received();
+            break;
+        case G28:
+            plotter->onG28Received();
+            break;
+        case G1Absolute:
+        case G1Relative:
+            plotter->onG1Received(last_x, last_y, opcode == G1Relative);
+            break;
+        }
+        return true;
+    }
+};
+}
+
+#endif /* BINARYJOB_H_ */
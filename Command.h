@@ -0,0 +1,142 @@
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+#include "Coordinate.h"
+#include <cstdint>
+#include <type_traits>
+
+/*
+ * One parsed G-code line as a small, trivially-copyable record, so it can go through a FreeRTOS queue by value.
+ * This decouples parsing (UART task) from execution (whoever drains the queue).
+ */
+struct Command {
+    enum Tag : uint8_t { M1, M2, M4, M5, M10, M11, G1, G28, Error };
+
+    struct PenPosition { uint8_t position; };
+    struct PenLimits { uint8_t up, down; };
+    struct LaserPower { uint8_t power; };
+    struct Settings { uint8_t a_step, b_step, speed; uint32_t height, width; };
+    struct Move { int32_t x, y; uint8_t relative; }; // Micrometres, see Coordinate
+
+    Tag tag;
+    union {
+        PenPosition m1;
+        PenLimits m2;
+        LaserPower m4;
+        Settings m5;
+        Move g1;
+        char const* reason; // Always one of the static GCodeScanner reasons, so the pointer stays valid
+    };
+
+    [[nodiscard]] bool operator==(Command const& other) const noexcept {
+        if (tag != other.tag)
+            return false;
+
+        switch (tag) {
+        case M1: return m1.position == other.m1.position;
+        case M2: return m2.up == other.m2.up && m2.down == other.m2.down;
+        case M4: return m4.power == other.m4.power;
+        case M5: return m5.a_step == other.m5.a_step && m5.b_step == other.m5.b_step && m5.speed == other.m5.speed
+                && m5.height == other.m5.height && m5.width == other.m5.width;
+        case G1: return g1.x == other.g1.x && g1.y == other.g1.y && g1.relative == other.g1.relative;
+        case Error: return reason == other.reason;
+        default: return true;
+        }
+    }
+
+    /* Calls the matching callback on plotter, exactly as the parser would have */
+    template <typename Plotter>
+    void execute(Plotter& plotter) const {
+        switch (tag) {
+        case M1:
+            plotter.onM1Received(m1.position);
+            break;
+        case M2:
+            plotter.onM2Received(m2.up, m2.down);
+            break;
+        case M4:
+            plotter.onM4Received(m4.power);
+            break;
+        case M5:
+            plotter.onM5Received(m5.a_step, m5.b_step, m5.height, m5.width, m5.speed);
+            break;
+        case M10:
+            plotter.onM10Received();
+            break;
+        case M11:
+            plotter.onM11Received();
+            break;
+        case G1:
+            plotter.onG1Received(Coordinate::fromMicrometres(g1.x), Coordinate::fromMicrometres(g1.y), g1.relative);
+            break;
+        case G28:
+            plotter.onG28Received();
+            break;
+        case Error:
+            plotter.onError(reason);
+            break;
+        }
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<Command>);
+
+/* A GCodeParser handler that turns each callback into a Command and hands it to sink, a callable taking Command const& */
+template <typename Sink>
+class CommandEncoder {
+public:
+    CommandEncoder(Sink sink) : sink{ sink } {}
+
+    void onM1Received(uint8_t pen_position) {
+        Command command{ Command::M1, {} };
+        command.m1 = { pen_position };
+        sink(command);
+    }
+
+    void onM2Received(uint8_t pen_up, uint8_t pen_down) {
+        Command command{ Command::M2, {} };
+        command.m2 = { pen_up, pen_down };
+        sink(command);
+    }
+
+    void onM4Received(uint8_t laser_power) {
+        Command command{ Command::M4, {} };
+        command.m4 = { laser_power };
+        sink(command);
+    }
+
+    void onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) {
+        Command command{ Command::M5, {} };
+        command.m5 = { a_step, b_step, speed, height, width };
+        sink(command);
+    }
+
+    void onM10Received() {
+        sink(Command{ Command::M10, {} });
+    }
+
+    void onM11Received() {
+        sink(Command{ Command::M11, {} });
+    }
+
+    void onG1Received(Coordinate x, Coordinate y, uint8_t relative) {
+        Command command{ Command::G1, {} };
+        command.g1 = { x.micrometres(), y.micrometres(), relative };
+        sink(command);
+    }
+
+    void onG28Received() {
+        sink(Command{ Command::G28, {} });
+    }
+
+    void onError(char const* reason) {
+        Command command{ Command::Error, {} };
+        command.reason = reason;
+        sink(command);
+    }
+
+private:
+    Sink sink;
+};
+
+#endif /* COMMAND_H_ */
@@ -0,0 +1,68 @@
+#ifndef COORDINATE_H_
+#define COORDINATE_H_
+
+#include <cstdint>
+
+/*
+ * Fixed-point length, stored as integer micrometres. Covers +-2 km at 1 um resolution,
+ * so G1 coordinates can go from the parser to step counts without any soft-float maths.
+ */
+class Coordinate {
+public:
+    constexpr Coordinate() = default;
+
+    [[nodiscard]] constexpr static Coordinate fromMicrometres(int32_t const micrometres) noexcept {
+        return Coordinate{ micrometres };
+    }
+
+    /*
+     * mantissa * 10^-decimals millimetres, as decoded by GCodeScanner. Digits past 1 um are rounded off.
+     * False if the result is outside +-kMaxMicrometres, the maths is done in 64 bits so that it can't overflow first
+     */
+    [[nodiscard]] constexpr static bool fromDecimal(int32_t const mantissa, uint8_t const decimals, Coordinate& coordinate) noexcept {
+        int64_t scale{ 1 }, micrometres{ mantissa };
+
+        if (decimals <= kDecimals) {
+            for (uint8_t i = decimals; i < kDecimals; ++i)
+                scale *= 10;
+            micrometres *= scale;
+        } else {
+            for (uint8_t i = kDecimals; i < decimals; ++i)
+                scale *= 10;
+            micrometres = (micrometres + (micrometres < 0 ? -scale : scale) / 2) / scale;
+        }
+
+        if (micrometres < -kMaxMicrometres || micrometres > kMaxMicrometres)
+            return false;
+
+        coordinate = Coordinate{ static_cast<int32_t>(micrometres) };
+        return true;
+    }
+
+    [[nodiscard]] constexpr int32_t micrometres() const noexcept { return value; }
+
+    /* Rounds to the nearest step. Split into whole and fractional millimetres so that it stays in 32 bits */
+    [[nodiscard]] constexpr int32_t toSteps(int32_t const steps_per_mm) const noexcept {
+        int32_t const whole = value / kPerMillimetre, fraction = value % kPerMillimetre;
+        return whole * steps_per_mm + (fraction * steps_per_mm + (fraction < 0 ? -kPerMillimetre : kPerMillimetre) / 2) / kPerMillimetre;
+    }
+
+    constexpr Coordinate operator+(Coordinate const other) const noexcept { return Coordinate{ value + other.value }; }
+    constexpr Coordinate operator-(Coordinate const other) const noexcept { return Coordinate{ value - other.value }; }
+    constexpr Coordinate& operator+=(Coordinate const other) noexcept { value += other.value; return *this; }
+    constexpr Coordinate& operator-=(Coordinate const other) noexcept { value -= other.value; return *this; }
+    constexpr bool operator==(Coordinate const other) const noexcept { return value == other.value; }
+    constexpr bool operator!=(Coordinate const other) const noexcept { return value != other.value; }
+    constexpr bool operator<(Coordinate const other) const noexcept { return value < other.value; }
+
+private:
+    constexpr explicit Coordinate(int32_t const micrometres) noexcept : value{ micrometres } {}
+
+    int32_t value{ 0 };
+
+    constexpr static uint8_t kDecimals{ 3 };
+    constexpr static int32_t kPerMillimetre{ 1'000 };
+    constexpr static int64_t kMaxMicrometres{ 2'000'000'000 };
+};
+
+#endif /* COORDINATE_H_ */
@@ -12,6 +12,14 @@ Mutex::Mutex() {
 	mutex = xSemaphoreCreateMutex();
 }
 
+Mutex::Mutex(SemaphoreHandle_t const mutex) : mutex{ mutex } {
+}
+
+#if configSUPPORT_STATIC_ALLOCATION
+MutexStatic::MutexStatic() : Mutex{ xSemaphoreCreateMutexStatic(&control) } {
+}
+#endif
+
 Mutex::~Mutex() {
 	vSemaphoreDelete(mutex);
 }
@@ -20,9 +20,25 @@ public:
 	void lock();
 	void unlock();
 
+protected:
+	explicit Mutex(SemaphoreHandle_t const mutex);
+
 private:
 	SemaphoreHandle_t mutex;
 };
+
+#if configSUPPORT_STATIC_ALLOCATION
+/* Storage for a static mutex, a base of its own so it exists before the mutex is created in it */
+struct MutexStorage {
+	StaticSemaphore_t control;
+};
+
+/* The same mutex with its control block inside the object, so it never touches the heap */
+class MutexStatic : private MutexStorage, public Mutex {
+public:
+	MutexStatic();
+};
+#endif
 }
 
 #endif /* FREERTOS_MUTEX_H_ */
@@ -25,27 +25,40 @@ public:
 	Queue(Queue const & queue) = delete;
 	Queue(Queue&&) = delete;
 
+	/*
+	 * From an interrupt these never wait, and if they wake a higher priority task it runs as soon as the interrupt
+	 * returns rather than at the next tick.
+	 */
 	void push_front(const T& t, TickType_t ticksToWait = 0) noexcept {
-		if (!is_interrupt())
+		if (!is_interrupt()) {
 			xQueueSendToFront(queue, &t, ticksToWait);
-		else
-			xQueueSendToFrontFromISR(queue, &t, nullptr);
+		} else {
+			portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+			xQueueSendToFrontFromISR(queue, &t, &xHigherPriorityWoken);
+			portYIELD_FROM_ISR(xHigherPriorityWoken);
+		}
 	}
 
 	void push_back(const T& t, TickType_t ticksToWait = 0) noexcept {
-		if (!is_interrupt())
+		if (!is_interrupt()) {
 			xQueueSendToBack(queue, &t, ticksToWait);
-		else
-			xQueueSendToBackFromISR(queue, &t, nullptr);
+		} else {
+			portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+			xQueueSendToBackFromISR(queue, &t, &xHigherPriorityWoken);
+			portYIELD_FROM_ISR(xHigherPriorityWoken);
+		}
 	}
 
 	// I guess anything that constructs a T could potentially throw an exception?
 	[[nodiscard]] T pop_back(TickType_t ticksToWait = portMAX_DELAY) {
 		T t;
-		if (!is_interrupt())
+		if (!is_interrupt()) {
 			xQueueReceive(queue, &t, ticksToWait);
-		else
-			xQueueReceiveFromISR(queue, &t, nullptr);
+		} else {
+			portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+			xQueueReceiveFromISR(queue, &t, &xHigherPriorityWoken); // A sender blocked on a full queue may be waiting
+			portYIELD_FROM_ISR(xHigherPriorityWoken);
+		}
 		return t;
 	}
 
@@ -60,7 +73,7 @@ public:
 
 	[[nodiscard]] bool empty() noexcept {
 		if (!is_interrupt())
-			return uxQueueMessagesWaiting(queue);
+			return uxQueueMessagesWaiting(queue) == 0;
 		else
 			return xQueueIsQueueEmptyFromISR(queue);
 	}
@@ -72,6 +85,9 @@ public:
 			return uxQueueMessagesWaitingFromISR(queue);
 	}
 
+protected:
+	explicit Queue(QueueHandle_t const queue) : queue{ queue } { }
+
 private:
 	QueueHandle_t queue;
 
@@ -79,6 +95,22 @@ private:
 		return SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
 	}
 };
+
+#if configSUPPORT_STATIC_ALLOCATION
+/* Storage for a static queue, a base of its own so it exists before the queue is created in it */
+template <typename T, size_t S>
+struct QueueStorage {
+	StaticQueue_t control;
+	uint8_t buffer[S * sizeof(T)];
+};
+
+/* The same queue with its control block and items inside the object, so it never touches the heap */
+template <typename T, size_t S>
+class QueueStatic : private QueueStorage<T, S>, public Queue<T, S> {
+public:
+	QueueStatic() : Queue<T, S>{ xQueueCreateStatic(S, sizeof(T), this->buffer, &this->control) } { }
+};
+#endif
 }
 
 #endif /* FREERTOS_QUEUE_H_ */
@@ -24,6 +24,34 @@ void inline bind(
 	static_assert( std::is_invocable<F, T*>::value );
 	xTaskCreate((TaskFunction_t) +f, name, stack_size, parameter, priority, created_task);
 }
+
+#if configSUPPORT_STATIC_ALLOCATION
+/*
+ * The same, but with the stack and control block inside the object, so creating it never touches the heap.
+ * The task lives as long as the object does, so make it static.
+ */
+template <configSTACK_DEPTH_TYPE StackSize>
+class Task {
+public:
+	template <typename F, typename T>
+	Task(F&& f, T* parameter, char const * const name, UBaseType_t priority = tskIDLE_PRIORITY + 1UL)
+	: task{ xTaskCreateStatic((TaskFunction_t) +f, name, StackSize, parameter, priority, stack, &control) } {
+		static_assert( std::is_invocable<F, T*>::value );
+	}
+
+	Task(Task const &) = delete;
+	Task(Task&&) = delete;
+
+	[[nodiscard]] TaskHandle_t handle() const noexcept {
+		return task;
+	}
+
+private:
+	StackType_t stack[StackSize];
+	StaticTask_t control;
+	TaskHandle_t const task;
+};
+#endif
 }
 
 #endif /* FREERTOS_TASK_H_ */
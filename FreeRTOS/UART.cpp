@@ -6,8 +6,10 @@
  */
 
 #include <cstring>
+#include <algorithm>
 
 #include "UART.h"
+#include "task.h"
 
 static FreeRTOS::UART* u0;
 static FreeRTOS::UART* u1;
@@ -41,38 +43,185 @@ void UART2_IRQHandler(void) {
 	if (u2)
 		u2->isr();
 }
+
+void DMA_IRQHandler(void) {
+	/* All channels share one interrupt, each UART checks its own */
+	if (u0)
+		u0->dmaIsr();
+	if (u1)
+		u1->dmaIsr();
+	if (u2)
+		u2->dmaIsr();
+}
 }
 
 namespace FreeRTOS {
 void UART::isr() {
+	portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+
 	/* Handle transmit interrupt if enabled */
-	if (uart->STAT & UART_STAT_TXRDY) {
-		uint8_t ch;
+	if (uart->STAT & UART_STAT_TXRDY)
+		transmit(&xHigherPriorityWoken);
 
-		/* Fill FIFO until full or until TX ring buffer is empty */
-		while (uart->STAT & UART_STAT_TXRDY && RingBuffer_Pop(&txring, &ch))
-			Chip_UART_SendByte(uart, ch);
+	/* Handle receive interrupt. The reader only wants waking once there's enough for it, not for every byte */
+	bool line_end = false;
+	while (uart->STAT & UART_STAT_RXRDY) {
+		char const ch = Chip_UART_ReadByte(uart);
+		if (!rxring.push(ch)) // The reader has fallen a whole buffer behind
+			rx_lost = true;
+		line_end = line_end || ch == '\r' || ch == '\n';
+	}
 
-		/* Disable transmit interrupt if the ring buffer is empty */
-		if (RingBuffer_IsEmpty(&txring))
-			uart->INTENCLR = UART_INTEN_TXRDY;
+	if (line_end || static_cast<int>(rxring.size()) >= rx_wanted)
+		read_ready.give(&xHigherPriorityWoken);
 
-		xSemaphoreGiveFromISR(write_complete, nullptr);
+	portEND_SWITCHING_ISR(xHigherPriorityWoken);
+}
 
+/* Fills the FIFO from the queued transfers until it's full or they have all gone */
+void UART::transmit(portBASE_TYPE* const xHigherPriorityWoken) noexcept {
+	while (transfer_tail != transfer_head && uart->STAT & UART_STAT_TXRDY) {
+		Transfer const & transfer = transfers[transfer_tail % kTransfers];
+		Chip_UART_SendByte(uart, transfer.data[sent]);
+		if (++sent == transfer.len)
+			complete(xHigherPriorityWoken);
 	}
 
-	/* Handle receive interrupt */
-	while (uart->STAT & UART_STAT_RXRDY) {
-		uint8_t ch = Chip_UART_ReadByte(uart);
-		RingBuffer_Insert(&rxring, &ch);
-		xSemaphoreGiveFromISR(read_ready, nullptr);
+	/* Disable transmit interrupt once there's nothing left */
+	if (transfer_tail == transfer_head)
+		uart->INTENCLR = UART_INTEN_TXRDY;
+}
+
+/* Hands the rest of the oldest transfer, or as much as fits one descriptor, to the DMA. Only when it's idle */
+void UART::transmitDma() noexcept {
+	if (transfer_tail == transfer_head)
+		return;
+
+	Transfer const & transfer = transfers[transfer_tail % kTransfers];
+	in_flight = std::min(transfer.len - sent, kDmaMaxTransfer);
+
+	Chip_DMA_Table[tx_channel].source = DMA_ADDR(&transfer.data[sent + in_flight - 1]);
+	Chip_DMA_Table[tx_channel].dest = DMA_ADDR(&uart->TXDATA);
+	Chip_DMA_Table[tx_channel].next = 0;
+	Chip_DMA_SetValidChannel(LPC_DMA, tx_channel);
+	Chip_DMA_SetupTranfer(LPC_DMA, tx_channel, DMA_XFERCFG_CFGVALID | DMA_XFERCFG_SETINTA | DMA_XFERCFG_SWTRIG
+			| DMA_XFERCFG_WIDTH_8 | DMA_XFERCFG_SRCINC_1 | DMA_XFERCFG_DSTINC_0 | DMA_XFERCFG_XFERCOUNT(in_flight));
+}
+
+/* The oldest transfer has gone: release its slice of txbuff, tell whoever queued it and wake anyone waiting for room */
+void UART::complete(portBASE_TYPE* const xHigherPriorityWoken) noexcept {
+	Transfer const & transfer = transfers[transfer_tail % kTransfers];
+	onWriteDoneCallback const callback = transfer.callback;
+
+	tx_tail += transfer.reserved;
+	sent = 0;
+	++transfer_tail;
+
+	if (callback != nullptr)
+		callback(xHigherPriorityWoken);
+	write_complete.give(xHigherPriorityWoken);
+}
+
+/*
+ * With DMA nothing touches the CPU per byte. A received half buffer interrupts once, and read() also checks how far
+ * the DMA has got whenever it wakes, at least once a tick, so a short burst that doesn't fill a half is never left
+ * waiting for the rest. At 1 Mbaud a half (256 bytes) fills in about 2.5 ms, so the reader has to keep up within the
+ * other half. If it falls a whole buffer behind, the oldest bytes are overwritten, and peek() drops the lot.
+ */
+void UART::dmaIsr() {
+	if (!dma)
+		return;
+
+	portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+	uint32_t const active = Chip_DMA_GetActiveIntAChannels(LPC_DMA);
+
+	if (active & (1 << rx_channel)) {
+		Chip_DMA_ClearActiveIntAChannel(LPC_DMA, rx_channel);
+		++rx_halves;
+		read_ready.give(&xHigherPriorityWoken);
+	}
+
+	if (active & (1 << tx_channel)) {
+		Chip_DMA_ClearActiveIntAChannel(LPC_DMA, tx_channel);
+
+		sent += in_flight;
+		in_flight = 0;
+		if (sent == transfers[transfer_tail % kTransfers].len)
+			complete(&xHigherPriorityWoken);
+		transmitDma();
 	}
+
+	portEND_SWITCHING_ISR(xHigherPriorityWoken);
+}
+
+void UART::dmaInit() {
+	if (!isDmaInit) {
+		Chip_DMA_Init(LPC_DMA);
+		Chip_DMA_Enable(LPC_DMA);
+		Chip_DMA_SetSRAMBase(LPC_DMA, DMA_ADDR(Chip_DMA_Table));
+		NVIC_EnableIRQ(DMA_IRQn);
+		isDmaInit = true;
+	}
+
+	/* Fixed request lines: USARTn RX is channel 2n, TX is 2n + 1 */
+	if (uart == LPC_USART0) {
+		rx_channel = DMAREQ_USART0_RX;
+		tx_channel = DMAREQ_USART0_TX;
+	} else if (uart == LPC_USART1) {
+		rx_channel = DMAREQ_USART1_RX;
+		tx_channel = DMAREQ_USART1_TX;
+	} else if (uart == LPC_USART2) {
+		rx_channel = DMAREQ_USART2_RX;
+		tx_channel = DMAREQ_USART2_TX;
+	}
+
+	for (int channel : { rx_channel, tx_channel }) {
+		Chip_DMA_EnableChannel(LPC_DMA, channel);
+		Chip_DMA_EnableIntChannel(LPC_DMA, channel);
+		Chip_DMA_SetupChannelConfig(LPC_DMA, channel, DMA_CFG_PERIPHREQEN | DMA_CFG_TRIGBURST_SNGL | DMA_CFG_CHPRIORITY(1));
+	}
+
+	/* Each half reloads the other and interrupts when it's full, so reception never stops */
+	uint32_t const xfercfg = DMA_XFERCFG_CFGVALID | DMA_XFERCFG_RELOAD | DMA_XFERCFG_SETINTA | DMA_XFERCFG_WIDTH_8
+			| DMA_XFERCFG_SRCINC_0 | DMA_XFERCFG_DSTINC_1 | DMA_XFERCFG_XFERCOUNT(kDmaRxSize / 2);
+
+	for (int half = 0; half < 2; ++half) {
+		rx_reload[half].xfercfg = xfercfg;
+		rx_reload[half].source = DMA_ADDR(&uart->RXDATA);
+		rx_reload[half].dest = DMA_ADDR(&dmarx[(half + 1) * kDmaRxSize / 2 - 1]); // Addresses are the end of the transfer
+		rx_reload[half].next = DMA_ADDR(&rx_reload[1 - half]);
+	}
+
+	Chip_DMA_Table[rx_channel] = rx_reload[0];
+	Chip_DMA_SetValidChannel(LPC_DMA, rx_channel);
+	Chip_DMA_SetupTranfer(LPC_DMA, rx_channel, xfercfg | DMA_XFERCFG_SWTRIG);
+}
+
+/*
+ * The DMA loads each reload descriptor internally and never writes it back to the table, so the half being filled
+ * comes from counting completed halves instead. A half can complete while this runs, before dmaIsr() has counted it:
+ * its INTA flag is set by then, and the count left in XFERCOUNT already belongs to the next half. So read until the
+ * flag and the count of halves hold still around XFERCOUNT, then add the half the flag stands for.
+ * Counted from the start rather than wrapped, so that a full buffer waiting can't look like an empty one.
+ */
+uint32_t UART::rxHead() const noexcept {
+	uint32_t halves, remaining, pending;
+
+	do {
+		halves = rx_halves;
+		pending = Chip_DMA_GetActiveIntAChannels(LPC_DMA) & (1 << rx_channel);
+		remaining = ((LPC_DMA->DMACH[rx_channel].XFERCFG >> 16) & 0x3FF) + 1;
+	} while (pending != (Chip_DMA_GetActiveIntAChannels(LPC_DMA) & (1 << rx_channel)) || halves != rx_halves);
+
+	uint32_t const start = (halves + (pending != 0)) * (kDmaRxSize / 2);
+	return start + kDmaRxSize / 2 - std::min<uint32_t>(remaining, kDmaRxSize / 2);
 }
 
 bool UART::isInit = false;
+bool UART::isDmaInit = false;
 
-UART::UART(const LpcUartConfig &cfg) : uart{ cfg.pUART }, read_ready{ xSemaphoreCreateCounting(UART_RB_SIZE, 0) },
-		write_complete{ xSemaphoreCreateBinary() } {
+UART::UART(const LpcUartConfig &cfg) : uart{ cfg.pUART }, read_ready{ kReadReady },
+		write_complete{ kWriteComplete }, dma{ cfg.dma } {
 	if (!isInit) {
 		/* Before setting up the UART, the global UART clock for USARTS 1-4
 		 * must first be setup. This requires setting the UART divider and
@@ -90,7 +239,7 @@ UART::UART(const LpcUartConfig &cfg) : uart{ cfg.pUART }, read_ready{ xSemaphore
 			Chip_SWM_MovablePortPinAssign(SWM_UART0_TXD_O, cfg.tx.port, cfg.tx.pin);
 		else if (cfg.pUART == LPC_USART1)
 			Chip_SWM_MovablePortPinAssign(SWM_UART1_TXD_O, cfg.tx.port, cfg.tx.pin);
-		else if (cfg.pUART == LPC_USART1)
+		else if (cfg.pUART == LPC_USART2)
 			Chip_SWM_MovablePortPinAssign(SWM_UART2_TXD_O, cfg.tx.port, cfg.tx.pin);
 	}
 
@@ -100,7 +249,7 @@ UART::UART(const LpcUartConfig &cfg) : uart{ cfg.pUART }, read_ready{ xSemaphore
 			Chip_SWM_MovablePortPinAssign(SWM_UART0_RXD_I, cfg.rx.port, cfg.rx.pin);
 		else if (cfg.pUART == LPC_USART1)
 			Chip_SWM_MovablePortPinAssign(SWM_UART1_RXD_I, cfg.rx.port, cfg.rx.pin);
-		else if (cfg.pUART == LPC_USART1)
+		else if (cfg.pUART == LPC_USART2)
 			Chip_SWM_MovablePortPinAssign(SWM_UART2_RXD_I, cfg.rx.port, cfg.rx.pin);
 	}
 
@@ -132,12 +281,11 @@ UART::UART(const LpcUartConfig &cfg) : uart{ cfg.pUART }, read_ready{ xSemaphore
 	Chip_UART_Enable(uart);
 	Chip_UART_TXEnable(uart);
 
-	/* Before using the ring buffers, initialize them using the ring buffer init function */
-	RingBuffer_Init(&rxring, rxbuff, 1, UART_RB_SIZE);
-	RingBuffer_Init(&txring, txbuff, 1, UART_RB_SIZE);
-
-	/* Enable receive data and line status interrupt */
-	Chip_UART_IntEnable(uart, UART_INTEN_RXRDY);
+	/* Enable receive data and line status interrupt, unless the DMA is taking the data instead */
+	if (dma)
+		dmaInit();
+	else
+		Chip_UART_IntEnable(uart, UART_INTEN_RXRDY);
 	Chip_UART_IntDisable(uart, UART_INTEN_TXRDY);   /* May not be needed */
 
 	/* Enable UART interrupt */
@@ -171,20 +319,121 @@ UART::~UART() {
 
 
 int UART::free() noexcept {
-	return RingBuffer_GetCount(&txring);;
+	return UART_RB_SIZE - (tx_head - tx_tail);
 }
 
 int  UART::peek() noexcept {
-	return RingBuffer_GetCount(&rxring);
+	if (!dma)
+		return rxring.size();
+
+	uint32_t const head = rxHead();
+	if (head - rx_tail > kDmaRxSize) { // Lapped: the oldest waiting bytes have been overwritten, the rest can't be trusted
+		rx_tail = head;
+		rx_lost = true;
+	}
+	return head - rx_tail;
 }
 
-char  UART::read() noexcept {
-	xSemaphoreTake(read_ready, portMAX_DELAY); // Alert read() to wake up
+char UART::read() noexcept {
 	char c;
-	Chip_UART_ReadRB(uart, &rxring, &c, 1);
+	while (read(&c, 1, portMAX_DELAY) == 0);
 	return c;
 }
 
+int UART::read(char * buffer, int const len, TickType_t const timeout) noexcept {
+	await(std::min(len, UART_RB_SIZE / 2), timeout, true);
+
+	int const count = std::min(len, peek());
+	if (rx_lost.exchange(false))
+		return kLost;
+
+	take(buffer, count);
+	return count;
+}
+
+int UART::readLine(char * buffer, int const max, TickType_t ticks) noexcept {
+	if (max < 2) // No room for a character and the NUL
+		return -1;
+
+	TimeOut_t timeout;
+	vTaskSetTimeOutState(&timeout);
+
+	int const piece = std::min(max - 1, UART_RB_SIZE / 2); // Never wait for more than the receive buffer can hold
+
+	while (true) {
+		/* The LF of a CR LF left over from the last line, or empty lines */
+		int available = peek();
+		if (rx_lost.exchange(false))
+			return kLost;
+
+		int skip = 0;
+		while (skip < available && (at(skip) == '\r' || at(skip) == '\n'))
+			++skip;
+		take(nullptr, skip);
+		available -= skip;
+
+		int const end = find(available);
+		if (end >= 0 || available >= piece) {
+			int const len = end >= 0 ? std::min(end, piece) : piece;
+			take(buffer, len);
+			buffer[len] = '\0';
+			return len;
+		}
+
+		if (xTaskCheckForTimeOut(&timeout, &ticks) == pdTRUE)
+			return -1;
+		await(piece, ticks, false);
+	}
+}
+
+/*
+ * Sleeps until wanted bytes or a line end are waiting, or ticks run out. With quiet set, the first byte wakes it too,
+ * and from then on a burst that stops short of either ends the wait once nothing more has come for kQuietTicks.
+ * The DMA doesn't signal line ends, so in DMA mode this looks for itself every kQuietTicks.
+ */
+void UART::await(int const wanted, TickType_t ticks, bool const quiet) noexcept {
+	TimeOut_t timeout;
+	vTaskSetTimeOutState(&timeout);
+
+	for (int available = -1;;) {
+		rx_wanted = (quiet && available <= 0) ? 1 : wanted; // Before looking, so a byte can't slip in unsignalled
+
+		int const now = peek();
+		if (now >= wanted || find(now) >= 0 || (quiet && now > 0 && now == available))
+			return;
+		available = now;
+
+		if (xTaskCheckForTimeOut(&timeout, &ticks) == pdTRUE)
+			return;
+		read_ready.take((dma || (quiet && now > 0)) ? std::min(ticks, kQuietTicks) : ticks);
+	}
+}
+
+int UART::find(int const available) noexcept {
+	for (int i = 0; i < available; ++i)
+		if (at(i) == '\r' || at(i) == '\n')
+			return i;
+	return -1;
+}
+
+char UART::at(int const index) noexcept {
+	if (dma)
+		return dmarx[(rx_tail + index) % kDmaRxSize];
+	return rxring.at(index);
+}
+
+void UART::take(char * buffer, int const len) noexcept {
+	if (dma) {
+		for (int i = 0; buffer != nullptr && i < len; ++i)
+			buffer[i] = at(i);
+		rx_tail += len;
+	} else if (buffer != nullptr) {
+		rxring.pop_n(buffer, len);
+	} else {
+		rxring.consume(len);
+	}
+}
+
 int UART::write(char c) noexcept {
 	return write(&c, 1);
 }
@@ -194,9 +443,94 @@ int UART::write(char const * buffer) noexcept {
 }
 
 int UART::write(char const * buffer, int const len) noexcept {
-	int res = Chip_UART_SendRB(uart, &txring, buffer, len);
-	xSemaphoreTake(write_complete, portMAX_DELAY); // Block write() from returning until tx_ring has emptied
-	return res;
+	for (int sent = 0; sent < len;) {
+		int const chunk = std::min(len - sent, kMaxReserve);
+		memcpy(reserve(chunk), buffer + sent, chunk);
+		if (!commit(chunk))
+			return sent;
+		sent += chunk;
+	}
+	return len;
+}
+
+bool UART::writeAsync(char const * buffer, int const len, onWriteDoneCallback callback) noexcept {
+	return len <= 0 || enqueue({ buffer, len, 0, callback }, 0);
+}
+
+char* UART::reserve(int const len) noexcept {
+	if (len < 0 || len > kMaxReserve) // Any more might never find room, and it would wait for it forever
+		return nullptr;
+
+	uint32_t const offset = tx_head % UART_RB_SIZE;
+	uint32_t const skip = offset + len > UART_RB_SIZE ? UART_RB_SIZE - offset : 0; // Never split a slice at the wrap
+
+	reserved = skip + len;
+	reserved_at = reinterpret_cast<char*>(&txbuff[(offset + skip) % UART_RB_SIZE]);
+
+	while (free() < reserved)
+		write_complete.take(portMAX_DELAY);
+	return reserved_at;
+}
+
+bool UART::commit(int const len, onWriteDoneCallback callback) noexcept {
+	int const slice = reserved;
+	reserved = 0;
+
+	if (len <= 0)
+		return true;
+
+	/* Taken before the transfer is queued, as its completion gives it back. Nothing else can have used it on failure */
+	tx_head += slice;
+	if (enqueue({ reserved_at, len, slice, callback }, portMAX_DELAY))
+		return true;
+
+	tx_head -= slice;
+	return false;
+}
+
+bool UART::enqueue(Transfer const & transfer, TickType_t const timeout) noexcept {
+	while (transfer_head - transfer_tail == kTransfers)
+		if (!write_complete.take(timeout) && timeout != portMAX_DELAY) // A notification may wake it for something else
+			return false;
+
+	transfers[transfer_head % kTransfers] = transfer;
+
+	/* The interrupt may be just finishing the last transfer, so it mustn't see the new one half started */
+	taskENTER_CRITICAL();
+	++transfer_head;
+	if (!dma)
+		uart->INTENSET = UART_INTEN_TXRDY;
+	else if (in_flight == 0)
+		transmitDma();
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+void UART::notify(TaskHandle_t const reader, TaskHandle_t const writer) noexcept {
+	read_ready.task = reader;
+	write_complete.task = writer;
+}
+
+void UART::Signal::give(portBASE_TYPE* const xHigherPriorityWoken) noexcept {
+	TaskHandle_t const waiting = task;
+	if (waiting != nullptr)
+		xTaskNotifyFromISR(waiting, bit, eSetBits, xHigherPriorityWoken);
+	else
+		xSemaphoreGiveFromISR(semaphore, xHigherPriorityWoken);
+}
+
+/* Either way a spurious wakeup is possible, every caller checks again what it was waiting for */
+bool UART::Signal::take(TickType_t const ticks) noexcept {
+	if (task == nullptr)
+		return xSemaphoreTake(semaphore, ticks) == pdTRUE;
+
+	uint32_t bits;
+	return xTaskNotifyWait(0, bit, &bits, ticks) == pdTRUE && (bits & bit);
+}
+
+void UART::flush() noexcept {
+	while (!txempty())
+		write_complete.take(portMAX_DELAY);
 }
 
 void UART::speed(int bps) noexcept {
@@ -204,6 +538,6 @@ void UART::speed(int bps) noexcept {
 }
 
 bool UART::txempty() {
-	return RingBuffer_GetCount(&txring) == 0;
+	return transfer_head == transfer_tail;
 }
 }
@@ -10,7 +10,11 @@
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 #include "chip.h"
+#include "SPSCRing.h"
+#include <atomic>
+#include <cstdint>
 
 namespace FreeRTOS {
 class UART {
@@ -29,31 +33,150 @@ public:
 		LpcPinMap rx{ -1, -1 };
 		LpcPinMap rts{ -1, -1 }; // used as output enable if RS-485 mode is enabled
 		LpcPinMap cts{ -1, -1 };
+		bool dma{ false }; // move the data with DMA instead of an interrupt per byte, see UART.cpp
 	};
 
+	/* Runs in the interrupt once a queued write has gone out, so its buffer can be reused */
+	using onWriteDoneCallback = void (*)(portBASE_TYPE* const xHigherPriorityWoken);
+
+	static constexpr int kTransfers = 8; // writes queued at once
+	static constexpr uint32_t kReadReady = 1UL << 30; // notification bits
+	static constexpr uint32_t kWriteComplete = 1UL << 31;
+	static constexpr TickType_t kQuietTicks = 2; // at least one whole tick, wherever in the tick the wait starts
+	static constexpr int kMaxReserve = 64; // half the transmit buffer, so a slice always fits once it has drained
+	static constexpr int kLost = -2; // read() and readLine(): received bytes were dropped, see read()
+
 	UART(const LpcUartConfig &cfg);
 	UART(const UART &) = delete;
 	~UART();
-	int  free(); /* get amount of free space in transmit buffer */
-	int  peek(); /* get number of received characters in receive buffer */
-	int  write(char c);
-	int  write(char const * buffer);
-	int  write(char const * buffer, int len);
-	char read(); /* get a single character. Returns number of characters read --> returns 0 if no character is available */
-	void speed(int bps); /* change transmission speed */
+	int  free() noexcept; /* get amount of free space in transmit buffer */
+	int  peek() noexcept; /* get number of received characters in receive buffer */
+
+	/*
+	 * Writes from more than one task have to be serialised by the caller, as before.
+	 * The copying writes return as soon as the data is in the transmit buffer, and only wait if it's full.
+	 * Longer writes stream through it a slice at a time.
+	 */
+	int  write(char c) noexcept;
+	int  write(char const * buffer) noexcept;
+	int  write(char const * buffer, int len) noexcept;
+
+	/*
+	 * Queues buffer to go out straight from the caller's memory, of any length, and returns without waiting.
+	 * buffer has to stay valid until callback has run. Returns false if kTransfers writes are already queued.
+	 */
+	bool writeAsync(char const * buffer, int len, onWriteDoneCallback callback = nullptr) noexcept;
+
+	/*
+	 * Or build the data in place: reserve() hands out len (at most kMaxReserve) contiguous bytes of the transmit
+	 * buffer, waiting for room if needed, and commit() queues the first len of them. One reservation at a time.
+	 * reserve() returns nullptr for a len it can never fit. If commit() fails, the slice goes back unsent.
+	 */
+	char* reserve(int len) noexcept;
+	bool commit(int len, onWriteDoneCallback callback = nullptr) noexcept;
+
+	void flush() noexcept; /* wait until everything queued has gone out */
+
+	/*
+	 * Wakes these tasks with direct notifications instead of the semaphores, which is quicker. Only for the one task
+	 * that reads, or the one that writes, and that doesn't clear kReadReady or kWriteComplete for its own use.
+	 * nullptr goes back to the semaphore.
+	 */
+	void notify(TaskHandle_t reader, TaskHandle_t writer = nullptr) noexcept;
+	char read() noexcept; /* get a single character. Blocks, without using any CPU, until one arrives */
+
+	/*
+	 * Reads whatever has arrived, up to len, waking at the first byte and then once per burst rather than per byte:
+	 * returns once len bytes or a line end are waiting, or once the line has gone quiet for kQuietTicks.
+	 * Returns 0 if nothing arrived within timeout. Returns kLost, once, if the reader fell so far behind that received
+	 * bytes were dropped: whatever was waiting then is gone too, and reading carries on with what came after.
+	 */
+	int  read(char * buffer, int len, TickType_t timeout) noexcept;
+
+	/*
+	 * Reads one line into buffer, NUL-terminated and without its CR or LF. Empty lines are skipped, and a line that
+	 * doesn't fit comes back in pieces. Returns its length, or -1 if no whole line arrived within timeout, or straight
+	 * away if max leaves no room for at least one character and the NUL. Or kLost, as for read().
+	 * A partial line is left waiting for the next call.
+	 */
+	int  readLine(char * buffer, int max, TickType_t timeout) noexcept;
+	void speed(int bps) noexcept; /* change transmission speed */
 	bool txempty();
 	void isr(); /* ISR handler. This will be called by the HW ISR handler. Do not call from application */
+	void dmaIsr(); /* same for the DMA interrupt */
 
 private:
 	LPC_USART_T* uart;
 	IRQn_Type irqn;
-	SemaphoreHandle_t read_ready, write_complete;
+
+	/*
+	 * A semaphore, or a notification to the task bound by notify(). The semaphore is kept in the object rather than on
+	 * the heap where the kernel is built with static allocation
+	 */
+	struct Signal {
+#if configSUPPORT_STATIC_ALLOCATION
+		StaticSemaphore_t storage;
+#endif
+		SemaphoreHandle_t const semaphore;
+		uint32_t const bit;
+		std::atomic<TaskHandle_t> task{ nullptr };
+
+#if configSUPPORT_STATIC_ALLOCATION
+		explicit Signal(uint32_t const bit) : semaphore{ xSemaphoreCreateBinaryStatic(&storage) }, bit{ bit } { }
+#else
+		explicit Signal(uint32_t const bit) : semaphore{ xSemaphoreCreateBinary() }, bit{ bit } { }
+#endif
+
+		void give(portBASE_TYPE* const xHigherPriorityWoken) noexcept;
+		bool take(TickType_t ticks) noexcept;
+	};
+
+	Signal read_ready, write_complete;
 	static constexpr int UART_RB_SIZE = 128; // currently we support only fixed size ring buffers
-	RINGBUFF_T txring;
-	RINGBUFF_T rxring;
-	uint8_t rxbuff[UART_RB_SIZE];
+	static_assert(2 * kMaxReserve <= UART_RB_SIZE, "A reserved slice has to fit however the buffer wraps");
+	SPSCRing<char, UART_RB_SIZE> rxring; // the interrupt fills it, the reading task empties it
+	std::atomic<int> rx_wanted{ 1 }; // the interrupt signals read_ready once this many bytes are waiting, or at a line end
+	std::atomic<bool> rx_lost{ false }; // received bytes were dropped since read() or readLine() last said so
 	uint8_t txbuff[UART_RB_SIZE];
 	static bool isInit; /* set when first UART is initialized. We have a global clock setting for all UARTSs */
+	/* Everything written goes out through transfers in order, from the caller's buffer or from a slice of txbuff */
+	struct Transfer {
+		char const * data;
+		int len;
+		int reserved; // txbuff bytes to release once it's gone, including any skipped at the wrap
+		onWriteDoneCallback callback;
+	};
+
+	Transfer transfers[kTransfers];
+	std::atomic<uint32_t> transfer_head{ 0 }, transfer_tail{ 0 }; // writers own head, the interrupt owns tail
+	std::atomic<uint32_t> tx_head{ 0 }, tx_tail{ 0 }; // txbuff in use, as free running counts
+	int sent{ 0 }; // bytes of the oldest transfer already gone, interrupt only
+	int in_flight{ 0 }; // bytes of it handed to the DMA
+	char* reserved_at{ nullptr };
+	int reserved{ 0 };
+
+	void await(int wanted, TickType_t ticks, bool quiet) noexcept;
+	[[nodiscard]] int find(int available) noexcept; /* index of the first line end waiting, or -1 */
+	[[nodiscard]] char at(int index) noexcept; /* a waiting byte, without taking it */
+	void take(char * buffer, int len) noexcept; /* nullptr just drops them */
+	bool enqueue(Transfer const & transfer, TickType_t timeout) noexcept;
+	void transmit(portBASE_TYPE* const xHigherPriorityWoken) noexcept;
+	void transmitDma() noexcept;
+	void complete(portBASE_TYPE* const xHigherPriorityWoken) noexcept;
+
+	/* DMA mode. RX runs continuously around dmarx in two halves that reload each other, TX sends each transfer as is */
+	static constexpr int kDmaRxSize = 512;
+	static constexpr int kDmaMaxTransfer = 1024; // XFERCOUNT is 10 bits
+	bool const dma;
+	int rx_channel{ -1 }, tx_channel{ -1 };
+	uint32_t rx_tail{ 0 }; // bytes taken, free running like rxHead()
+	std::atomic<uint32_t> rx_halves{ 0 }; // halves the DMA has filled, counted by dmaIsr(). Its low bit is the half being filled now
+	uint8_t dmarx[kDmaRxSize];
+	DMA_CHDESC_T rx_reload[2] __attribute__((aligned(16)));
+	static bool isDmaInit;
+
+	void dmaInit();
+	uint32_t rxHead() const noexcept; /* bytes the DMA has received, free running. Modulo kDmaRxSize it's where the next one goes */
 };
 }
 
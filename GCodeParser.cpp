@@ -1,113 +1,182 @@
 #include "GCodeParser.h"
 
-GCodeParser::GCodeParser(PlotterInterface* plotter) : plotter{ plotter } {}
-
-void GCodeParser::parse(char const* g_code) {
-    switch (g_code[0]) {
-    case 'G':
-        switch (std::atoi(g_code + 1)) {
-        case 1: {
-            float x{ 0 }, y{ 0 };
-            uint8_t relative{ 0 };
-
-            if (std::sscanf(g_code + 3, "X%f Y%f A%c", &x, &y, &relative) == 3) {
-                if (plotter != nullptr)
-                    plotter->onG1Received(x, y, relative);
-            } else {
-                if (plotter != nullptr)
-                    plotter->onError(kMalformedCode);
-            }
-            break;
-        }
+bool GCodeScanner::scan(char const c) noexcept {
+    if (c == '\r' || c == '\n')
+        return endLine();
+
+    switch (state) {
+    case State::Idle:
+        if (c != ' ' && c != '\t')
+            beginLine(c);
+        break;
 
-        case 28:
-            if (plotter != nullptr)
-                plotter->onG28Received();
+    case State::Code:
+        if (scanner.accumulate(c))
             break;
 
-        default:
-            if (plotter != nullptr)
-                plotter->onError(kUnknownCode);
+        if (Number number; scanner.finish(number) && number.decimals == 0)
+            code = number.mantissa;
+        state = State::Separator;
+        rescan(c);
+        break;
+
+    case State::Separator:
+        if (c == ' ' || c == '\t') {
             break;
+        } else if (c == ';') {
+            state = State::Comment;
+        } else if (c >= 'A' && c <= 'Z') {
+            beginWord(c);
+        } else if (isNumberStart(c)) {
+            beginWord('\0');
+            (void) scan(c);
+        } else {
+            malformed = true;
+            state = State::Discard;
         }
         break;
 
-    case 'M':
-        switch (std::atoi(g_code + 1)) {
-        case 1: {
-            uint8_t pen_position{ 0 };
-
-            if (std::sscanf(g_code + 3, "%c", &pen_position) == 1) {
-                if (plotter != nullptr)
-                    plotter->onM1Received(pen_position);
-            } else {
-                if (plotter != nullptr)
-                    plotter->onError(kMalformedCode);
-            }
+    case State::Value:
+        if (scanner.accumulate(c))
             break;
-        }
 
-        case 2: {
-            uint8_t up{ 0 }, down{ 0 };
+        endWord();
+        if (state == State::Separator)
+            rescan(c);
+        break;
 
-            if (std::sscanf(g_code + 3, "U%c D%c", &up, &down) == 2) {
-                if (plotter != nullptr)
-                    plotter->onM2Received(up, down);
-            } else {
-                if (plotter != nullptr)
-                    plotter->onError(kMalformedCode);
-            }
-            break;
-        }
+    case State::Comment:
+    case State::Discard:
+        break;
+    }
 
-        case 4: {
-            uint8_t laser_power{ 0 };
+    return false;
+}
 
-            if (std::sscanf(g_code + 3, "%c", &laser_power) == 1) {
-                if (plotter != nullptr)
-                    plotter->onM4Received(laser_power);
-            } else {
-                if (plotter != nullptr)
-                    plotter->onError(kMalformedCode);
-            }
-            break;
-        }
+void GCodeScanner::beginLine(char const c) noexcept {
+    command = c;
+    code = -1;
+    malformed = false;
+    word_count = 0;
+
+    if (c == 'G' || c == 'M') {
+        scanner = {};
+        state = State::Code;
+    } else {
+        state = State::Discard; // The parser reports Not a GCode at the end of the line
+    }
+}
+
+void GCodeScanner::beginWord(char const letter) noexcept {
+    if (word_count == kMaxWords) {
+        malformed = true;
+        state = State::Discard;
+        return;
+    }
+
+    words[word_count].letter = letter;
+    scanner = {};
+    state = State::Value;
+}
+
+void GCodeScanner::endWord() noexcept {
+    if (scanner.finish(words[word_count].number)) {
+        ++word_count;
+        state = State::Separator;
+    } else {
+        malformed = true;
+        state = State::Discard;
+    }
+}
+
+/* Starts the next word on a byte the last number didn't take. If it could have been part of that number, two ran together (X1.2.3, X1-2) */
+void GCodeScanner::rescan(char const c) noexcept {
+    if (isNumberStart(c)) {
+        malformed = true;
+        state = State::Discard;
+    } else {
+        (void) scan(c);
+    }
+}
+
+void GCodeScanner::discard() noexcept {
+    if (state == State::Idle)
+        beginLine('\0'); // Reported as Not a GCode
+    malformed = true;
+    state = State::Discard;
+}
+
+bool GCodeScanner::endLine() noexcept {
+    if (state == State::Code) {
+        if (Number number; scanner.finish(number) && number.decimals == 0)
+            code = number.mantissa;
+    } else if (state == State::Value) {
+        endWord();
+    }
 
-        case 5: {
-            uint8_t a_step{ 0 }, b_step{ 0 }, speed{ 0 };
-            uint32_t height{ 0 }, width{ 0 };
+    bool const complete = state != State::Idle;
+    state = State::Idle;
+    return complete;
+}
+
+[[nodiscard]] GCodeScanner::Word const* GCodeScanner::find(char const letter) const noexcept {
+    for (size_t i = 0; i < word_count; ++i)
+        if (words[i].letter == letter)
+            return &words[i];
+    return nullptr;
+}
+
+[[nodiscard]] size_t GCodeScanner::wordCount() const noexcept {
+    return word_count;
+}
+
+[[nodiscard]] bool GCodeScanner::NumberScanner::accumulate(char const c) noexcept {
+    if (c >= '0' && c <= '9') {
+        if (!fraction || decimals < kMaxDecimals) { // Digits past kMaxDecimals are below our resolution, so just drop them
+            uint32_t const digit = c - '0';
 
-            if (std::sscanf(g_code + 3, "A%c B%c H%ld W%ld S%c", &a_step, &b_step, &height, &width, &speed) == 5) {
-                if (plotter != nullptr)
-                    plotter->onM5Received(a_step, b_step, height, width, speed);
+            if (magnitude > (INT32_MAX - digit) / 10) { // Still scanned to the end of the word, finish() then rejects it
+                overflow = true;
             } else {
-                if (plotter != nullptr)
-                    plotter->onError(kMalformedCode);
+                magnitude = magnitude * 10 + digit;
+                decimals += fraction;
             }
-            break;
         }
+        digits = true;
+    } else if (c == '.' && !fraction) {
+        fraction = true;
+    } else if ((c == '-' || c == '+') && !started) {
+        negative = c == '-';
+    } else {
+        return false;
+    }
 
-        case 10:
-            if (strlen(g_code) == 3) // Probably not necessary when reading mdraw codes from serial, but we need to skip M10 replies in logs
-                if (plotter != nullptr)
-                    plotter->onM10Received();
-            break;
+    started = true;
+    return true;
+}
 
-        case 11:
-            if (plotter != nullptr)
-                plotter->onM11Received();
-            break;
+/* Returns false if no digits were seen, or the mantissa didn't fit an int32_t */
+[[nodiscard]] bool GCodeScanner::NumberScanner::finish(Number& number) const noexcept {
+    if (!digits || overflow)
+        return false;
 
-        default:
-            if (plotter != nullptr)
-                plotter->onError(kUnknownCode);
-            break;
-        }
-        break;
+    number.mantissa = negative ? -static_cast<int32_t>(magnitude) : static_cast<int32_t>(magnitude);
+    number.decimals = decimals;
+    return true;
+}
 
-    default:
-        if (plotter != nullptr)
-            plotter->onError(kNotAGCode);
-        break;
-    }
+[[nodiscard]] bool GCodeScanner::isNumberStart(char const c) noexcept {
+    return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+';
+}
+
+[[nodiscard]] float GCodeScanner::toFloat(Number const number) noexcept {
+    return static_cast<float>(number.mantissa) / kPowersOf10[number.decimals];
+}
+
+[[nodiscard]] bool GCodeScanner::toCoordinate(Number const number, Coordinate& coordinate) noexcept {
+    return Coordinate::fromDecimal(number.mantissa, number.decimals, coordinate);
+}
+
+[[nodiscard]] int32_t GCodeScanner::toInteger(Number const number) noexcept {
+    return number.mantissa / kPowersOf10[number.decimals];
 }
@@ -5,18 +5,302 @@
 #include <algorithm>
 #include <cstring>
 #include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
 
-class GCodeParser {
+/* Handler-independent half of the parser. Decodes the command and its words one byte at a time */
+class GCodeScanner {
 public:
-    GCodeParser(PlotterInterface* plotter = nullptr);
-    void parse(char const* g_code);
+    /* Reasons passed to onError(). Arrays rather than pointers to literals, so the address is the same in every translation unit and handlers can compare against it */
+    constexpr static char kMalformedCode[] = "Malformed code\r\n";
+    constexpr static char kUnknownCode[] = "Unknown code\r\n";
+    constexpr static char kNotAGCode[] = "Not a GCode\r\n";
+    constexpr static char kUnsupportedCode[] = "Unsupported code\r\n";
+
+protected:
+    /* A decoded value is kept as an integer mantissa and a count of decimal digits, so no float maths happens while scanning */
+    struct Number {
+        int32_t mantissa;
+        uint8_t decimals;
+    };
+
+    /* A letter/value pair such as X12.5. Bare values (M1 90) are stored with letter '\0' */
+    struct Word {
+        char letter;
+        Number number;
+    };
+
+    char command{ 0 };
+    int32_t code{ -1 };
+    bool malformed{ false };
+
+    /* Returns true when a CR or LF has completed a non-empty line. The decoded line stays valid until the next byte is scanned */
+    [[nodiscard]] bool scan(char const c) noexcept;
+    void discard() noexcept;
+    [[nodiscard]] Word const* find(char letter) const noexcept;
+    [[nodiscard]] size_t wordCount() const noexcept;
+
+    [[nodiscard]] static float toFloat(Number const number) noexcept;
+    /* False if it's outside the +-2 km a Coordinate holds */
+    [[nodiscard]] static bool toCoordinate(Number const number, Coordinate& coordinate) noexcept;
+    [[nodiscard]] static int32_t toInteger(Number const number) noexcept;
+
+    /* False if it isn't a whole number (A0.9), or doesn't fit T, e.g. M1 300 or M1 -5 for a uint8_t argument */
+    template <typename T>
+    [[nodiscard]] static bool toInteger(Number const number, T& value) noexcept {
+        int64_t const integer = toInteger(number);
+
+        if (number.mantissa % kPowersOf10[number.decimals] != 0)
+            return false;
+        if (integer < static_cast<int64_t>(std::numeric_limits<T>::min()) || integer > static_cast<int64_t>(std::numeric_limits<T>::max()))
+            return false;
+
+        value = static_cast<T>(integer);
+        return true;
+    }
+
+private:
+    enum class State : uint8_t { Idle, Code, Separator, Value, Comment, Discard };
+
+    /* Decodes [+-]digits[.digits] one character at a time */
+    struct NumberScanner {
+        uint32_t magnitude;
+        uint8_t decimals;
+        bool negative, fraction, digits, started, overflow;
+
+        [[nodiscard]] bool accumulate(char const c) noexcept;
+        [[nodiscard]] bool finish(Number& number) const noexcept;
+    };
+
+    constexpr static size_t kMaxWords{ 6 };
+
+    State state{ State::Idle };
+    NumberScanner scanner{};
+    Word words[kMaxWords];
+    size_t word_count{ 0 };
+
+    void beginLine(char const c) noexcept;
+    void beginWord(char const letter) noexcept;
+    void endWord() noexcept;
+    void rescan(char const c) noexcept;
+    [[nodiscard]] bool endLine() noexcept;
+
+    [[nodiscard]] static bool isNumberStart(char const c) noexcept;
+
+    constexpr static uint8_t kMaxDecimals{ 6 };
+    constexpr static int32_t kPowersOf10[kMaxDecimals + 1]{ 1, 10, 100, 1'000, 10'000, 100'000, 1'000'000 };
+};
+
+/*
+ * GCodeParser<> (Plotter = PlotterInterface) is the runtime-polymorphic form: calls go through the vtable and a nullptr plotter is allowed.
+ * Any other Plotter binds the parser at compile time, so calls are direct (declare the handler final if it derives from
+ * PlotterInterface) and it must be given a valid handler. Such a handler may leave out commands it doesn't support;
+ * those lines are reported through onError(kUnsupportedCode), and dropped if there is no onError either.
+ */
+template <typename Plotter = PlotterInterface>
+class GCodeParser : public GCodeScanner {
+public:
+    GCodeParser(Plotter* plotter) : plotter{ plotter } {}
+
+    /* Only the runtime-polymorphic parser can be left without a handler */
+    template <typename P = Plotter, std::enable_if_t<std::is_same_v<P, PlotterInterface>, int> = 0>
+    GCodeParser() : plotter{ nullptr } {}
+
+    template <typename P = Plotter, std::enable_if_t<!std::is_same_v<P, PlotterInterface>, int> = 0>
+    GCodeParser(std::nullptr_t) = delete;
+
+    void parse(char const* g_code) {
+        while (*g_code != '\0')
+            feed(*g_code++);
+        feed('\n');
+    }
+
+    void parse(char const* g_code, size_t const length) { // g_code need not be NUL-terminated
+        feed(g_code, length);
+        feed('\n');
+    }
+
+    /* Streaming interface. Words are decoded as bytes arrive and the callback fires on the CR or LF that ends the line */
+    void feed(char const c) noexcept {
+        if (scan(c))
+            dispatch();
+    }
+
+    void feed(char const* buffer, size_t const length) noexcept {
+        for (size_t i = 0; i < length; ++i)
+            feed(buffer[i]);
+    }
+
+    /*
+     * For when input bytes went missing. Whatever arrives up to the next line end is dropped and reported through onError(),
+     * rather than run with part of it gone. Between lines that's the whole of the next one, as the loss may have ended mid-line
+     */
+    void skipLine() noexcept {
+        discard();
+    }
 
 private:
-    PlotterInterface* plotter;
+    Plotter* plotter;
+
+    constexpr static bool kNullable{ std::is_same_v<Plotter, PlotterInterface> };
+
+    /* call must be SFINAE-friendly (trailing decltype) so that handlers without the callback fall through to kUnsupportedCode */
+    template <typename Call>
+    void invoke(Call&& call) noexcept {
+        if constexpr (std::is_invocable_v<Call, Plotter&>) {
+            if constexpr (kNullable)
+                if (plotter == nullptr)
+                    return;
+            call(*plotter);
+        } else {
+            error(kUnsupportedCode);
+        }
+    }
+
+    void error(char const* reason) noexcept {
+        constexpr auto call = [](auto& p, char const* reason) -> decltype(p.onError(reason)) { p.onError(reason); };
+
+        if constexpr (std::is_invocable_v<decltype(call), Plotter&, char const*>) {
+            if constexpr (kNullable)
+                if (plotter == nullptr)
+                    return;
+            call(*plotter, reason);
+        }
+    }
+
+    void dispatch() noexcept {
+        switch (command) {
+        case 'G':
+            switch (code) {
+            case 1: {
+                auto const x = find('X'), y = find('Y'), relative = find('A');
+
+                uint8_t is_relative;
+                Coordinate x_fixed, y_fixed;
+
+                // Range-checked as Coordinates even for float handlers, so every handler sees the same lines rejected
+                if (!malformed && x != nullptr && y != nullptr && relative != nullptr && toInteger(relative->number, is_relative)
+                        && toCoordinate(x->number, x_fixed) && toCoordinate(y->number, y_fixed)) {
+                    constexpr auto fixed = [](auto& p, Coordinate x, Coordinate y, uint8_t r) -> decltype(p.onG1Received(x, y, r)) { p.onG1Received(x, y, r); };
+
+                    // Prefer the fixed-point callback, only handlers that don't have one pay for float conversion
+                    if constexpr (std::is_invocable_v<decltype(fixed), Plotter&, Coordinate, Coordinate, uint8_t>) {
+                        invoke([&](auto& p) { fixed(p, x_fixed, y_fixed, is_relative); });
+                    } else {
+                        float const x_mm = toFloat(x->number), y_mm = toFloat(y->number);
+                        invoke([&](auto& p) -> decltype(p.onG1Received(x_mm, y_mm, is_relative)) { p.onG1Received(x_mm, y_mm, is_relative); });
+                    }
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+            }
+
+            case 28:
+                if (!malformed) {
+                    invoke([](auto& p) -> decltype(p.onG28Received()) { p.onG28Received(); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+
+            default:
+                error(kUnknownCode);
+                break;
+            }
+            break;
+
+        case 'M':
+            switch (code) {
+            case 1: {
+                auto const pen_position = find('\0');
+
+                uint8_t position;
+
+                if (!malformed && pen_position != nullptr && toInteger(pen_position->number, position)) {
+                    invoke([&](auto& p) -> decltype(p.onM1Received(position)) { p.onM1Received(position); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+            }
+
+            case 2: {
+                auto const up = find('U'), down = find('D');
+
+                uint8_t pen_up, pen_down;
+
+                if (!malformed && up != nullptr && down != nullptr && toInteger(up->number, pen_up) && toInteger(down->number, pen_down)) {
+                    invoke([&](auto& p) -> decltype(p.onM2Received(pen_up, pen_down)) { p.onM2Received(pen_up, pen_down); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+            }
+
+            case 4: {
+                auto const laser_power = find('\0');
+
+                uint8_t power;
+
+                if (!malformed && laser_power != nullptr && toInteger(laser_power->number, power)) {
+                    invoke([&](auto& p) -> decltype(p.onM4Received(power)) { p.onM4Received(power); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+            }
+
+            case 5: {
+                auto const a_step = find('A'), b_step = find('B'), height = find('H'), width = find('W'), speed = find('S');
+
+                uint8_t a, b, s;
+                uint32_t h, w;
+
+                if (!malformed && a_step != nullptr && b_step != nullptr && height != nullptr && width != nullptr && speed != nullptr
+                        && toInteger(a_step->number, a) && toInteger(b_step->number, b) && toInteger(speed->number, s)
+                        && toInteger(height->number, h) && toInteger(width->number, w)) {
+                    invoke([&](auto& p) -> decltype(p.onM5Received(a, b, h, w, s)) { p.onM5Received(a, b, h, w, s); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+            }
+
+            case 10:
+                if (!malformed && wordCount() == 0) // Probably not necessary when reading mdraw codes from serial, but we need to skip M10 replies in logs
+                    invoke([](auto& p) -> decltype(p.onM10Received()) { p.onM10Received(); });
+                break;
+
+            case 11:
+                if (!malformed) {
+                    invoke([](auto& p) -> decltype(p.onM11Received()) { p.onM11Received(); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+
+            case 90: // A packed binary job follows this line, see BinaryJob.h
+                if (!malformed) {
+                    invoke([](auto& p) -> decltype(p.onM90Received()) { p.onM90Received(); });
+                } else {
+                    error(kMalformedCode);
+                }
+                break;
+
+            default:
+                error(kUnknownCode);
+                break;
+            }
+            break;
 
-    constexpr static auto kMalformedCode = "Malformed code\r\n";
-    constexpr static auto kUnknownCode = "Unknown code\r\n";
-    constexpr static auto kNotAGCode = "Not a GCode\r\n";
+        default:
+            error(kNotAGCode);
+            break;
+        }
+    }
 };
 
 #endif /* GCODEPARSER_H_ */
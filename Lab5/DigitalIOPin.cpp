@@ -123,9 +123,23 @@ void DigitalIOPin::setOnIRQCallback(onIRQCallback callback) {
 	this->callback = callback;
 }
 
+void DigitalIOPin::assign(CHIP_SWM_PIN_MOVABLE_T const function) {
+	Chip_SWM_MovablePortPinAssign(function, pin_map.port, pin_map.pin);
+}
+
+void DigitalIOPin::notify(TaskHandle_t task) {
+	this->task = task;
+}
+
+uint32_t DigitalIOPin::bit() const {
+	return 1UL << channel;
+}
+
 void DigitalIOPin::isr(portBASE_TYPE* const xHigherPriorityWoken) {
 	if (callback != nullptr)
 		callback(read(), xHigherPriorityWoken);
+	if (task != nullptr)
+		xTaskNotifyFromISR(task, bit(), eSetBits, xHigherPriorityWoken);
 }
 
 bool DigitalIOPin::isInit{ false };
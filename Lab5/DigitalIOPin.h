@@ -10,6 +10,7 @@
 
 #include "board.h"
 #include "FreeRTOS.h"
+#include "task.h"
 #include "LPCPinMap.h"
 
 class DigitalIOPin {
@@ -24,6 +25,13 @@ public:
 	void toggle();
 
 	void setOnIRQCallback(onIRQCallback callback);
+
+	/* Also wakes task on every edge, with a direct notification setting bit(), so it needs no semaphore. nullptr stops it */
+	void notify(TaskHandle_t task);
+	[[nodiscard]] uint32_t bit() const;
+
+	/* Also connects the pin to a movable switch matrix input, e.g. an SCT input, so a peripheral can react to it without an interrupt. read() and the pin interrupt keep working */
+	void assign(CHIP_SWM_PIN_MOVABLE_T const function);
 	void isr(portBASE_TYPE* const xHigherPriorityWoken);
 
 private:
@@ -32,6 +40,7 @@ private:
 	bool const invert;
 	IRQn_Type IRQn;
 	onIRQCallback callback;
+	TaskHandle_t task{ nullptr };
 
 	static bool isInit;
 	static constexpr IRQn_Type kNoIRQ	{ static_cast<IRQn_Type>(0) };
@@ -0,0 +1,158 @@
+/*
+ * Homing.cpp
+ */
+
+#include "Homing.h"
+
+SemaphoreHandle_t Homing::event{ nullptr };
+
+Homing::Homing(Switches const x, Switches const y) : switches{ x, y } {
+	if (event == nullptr)
+		event = xSemaphoreCreateBinary();
+
+	if (switches[Stepper::X_Axis].origin != nullptr) {
+		switches[Stepper::X_Axis].origin->setOnIRQCallback(onSwitch<Stepper::X_Axis>);
+		switches[Stepper::X_Axis].limit->setOnIRQCallback(onSwitch<Stepper::X_Axis>);
+	}
+	if (switches[Stepper::Y_Axis].origin != nullptr) {
+		switches[Stepper::Y_Axis].origin->setOnIRQCallback(onSwitch<Stepper::Y_Axis>);
+		switches[Stepper::Y_Axis].limit->setOnIRQCallback(onSwitch<Stepper::Y_Axis>);
+	}
+}
+
+[[nodiscard]] bool Homing::home(TickType_t const timeout) {
+	Stepper* const steppers[2]{ &Stepper::getXStepper(), &Stepper::getYStepper() };
+	size_t const steps_per_second[2]{ steppers[Stepper::X_Axis]->getStepsPerSecond(), steppers[Stepper::Y_Axis]->getStepsPerSecond() };
+
+	bool const homed = run(timeout);
+
+	for (size_t axis = 0; axis < 2; ++axis) // The slow approaches leave their own rate behind, whether they got anywhere or not
+		steppers[axis]->setStepsPerSecond(steps_per_second[axis]);
+	return homed;
+}
+
+[[nodiscard]] bool Homing::run(TickType_t const timeout) {
+	Stepper* const steppers[2]{ &Stepper::getXStepper(), &Stepper::getYStepper() };
+
+	for (size_t axis = 0; axis < 2; ++axis) {
+		if (switches[axis].origin != nullptr) {
+			steppers[axis]->halt();
+			steppers[axis]->clearState();
+		}
+	}
+
+	if (!approach(Origin, true, timeout) || !backOff(Origin, timeout) || !approach(Origin, false, timeout))
+		return false;
+
+	for (size_t axis = 0; axis < 2; ++axis)
+		if (switches[axis].origin != nullptr)
+			steppers[axis]->setOrigin();
+
+	if (!approach(Limit, true, timeout) || !backOff(Limit, timeout) || !approach(Limit, false, timeout))
+		return false;
+
+	int32_t travel[2]{ 0 };
+	for (size_t axis = 0; axis < 2; ++axis) {
+		if (switches[axis].origin != nullptr) {
+			steppers[axis]->setLimit();
+			travel[axis] = steppers[axis]->getLimit();
+		}
+	}
+
+	xSemaphoreTake(event, 0);
+	return Stepper::move(-travel[Stepper::X_Axis], -travel[Stepper::Y_Axis], onMoveDone) && xSemaphoreTake(event, timeout) == pdTRUE;
+}
+
+void Homing::onLimit(uint8_t input, portBASE_TYPE* const xHigherPriorityWoken) {
+	xSemaphoreGiveFromISR(event, xHigherPriorityWoken);
+}
+
+/*
+ * Runs the axes that aren't at end yet towards it until each one's switch is pressed. Fast, that's one ramped move per
+ * axis in turn, since a switch ends the move it's on. Slow, both free-run at once and each switch only stops its own axis
+ */
+[[nodiscard]] bool Homing::approach(End const end, bool const fast, TickType_t const timeout) {
+	Stepper* const steppers[2]{ &Stepper::getXStepper(), &Stepper::getYStepper() };
+	int32_t const travel = end == Origin ? -kMaxTravel : kMaxTravel;
+
+	for (size_t axis = 0; axis < 2; ++axis)
+		pending[axis] = switches[axis].origin != nullptr && !getSwitch(axis, end)->read();
+
+	xSemaphoreTake(event, 0); // Anything left over from the last phase
+
+	if (fast) {
+		for (size_t axis = 0; axis < 2; ++axis) {
+			if (!pending[axis])
+				continue;
+
+			xSemaphoreTake(event, 0); // The pin and the SCT2 interrupt both signal the last axis' switch
+			if (!Stepper::move(axis == Stepper::X_Axis ? travel : 0, axis == Stepper::Y_Axis ? travel : 0, onMoveDone))
+				return false;
+
+			bool const signalled = xSemaphoreTake(event, timeout) == pdTRUE;
+			steppers[axis]->halt();
+
+			if (!signalled || !getSwitch(axis, end)->read()) // Ran out of travel, or hit the wrong switch
+				return false;
+			pending[axis] = false;
+		}
+		return true;
+	}
+
+	for (size_t axis = 0; axis < 2; ++axis) {
+		if (pending[axis]) {
+			steppers[axis]->setStepsPerSecond(kSlowStepsPerSecond);
+			steppers[axis]->setDirection(end == Origin ? Stepper::Clockwise : Stepper::CounterClockwise);
+			steppers[axis]->resume();
+		}
+	}
+
+	bool stray{ false };
+	while ((pending[Stepper::X_Axis] || pending[Stepper::Y_Axis]) && !stray && xSemaphoreTake(event, timeout) == pdTRUE) {
+		for (size_t axis = 0; axis < 2; ++axis) {
+			if (pending[axis] && getSwitch(axis, end)->read()) {
+				steppers[axis]->halt();
+				pending[axis] = false;
+			} else if (pending[axis] && getSwitch(axis, end == Origin ? Limit : Origin)->read()) { // Hit the wrong switch
+				stray = true;
+			}
+		}
+	}
+
+	for (size_t axis = 0; axis < 2; ++axis) // Whatever's still running after a timeout or the wrong switch
+		if (pending[axis])
+			steppers[axis]->halt();
+	return !pending[Stepper::X_Axis] && !pending[Stepper::Y_Axis];
+}
+
+[[nodiscard]] bool Homing::backOff(End const end, TickType_t const timeout) {
+	int32_t const away = end == Origin ? kBackOffSteps : -kBackOffSteps;
+
+	xSemaphoreTake(event, 0);
+	if (!Stepper::move(switches[Stepper::X_Axis].origin != nullptr ? away : 0, switches[Stepper::Y_Axis].origin != nullptr ? away : 0, onMoveDone)
+			|| xSemaphoreTake(event, timeout) != pdTRUE)
+		return false;
+
+	for (size_t axis = 0; axis < 2; ++axis)
+		if (switches[axis].origin != nullptr && getSwitch(axis, end)->read())
+			return false;
+	return true;
+}
+
+[[nodiscard]] DigitalIOPin* Homing::getSwitch(size_t const axis, End const end) const noexcept {
+	return end == Origin ? switches[axis].origin : switches[axis].limit;
+}
+
+/*
+ * Only wakes the homing task, which halts the axis. halt() masks the step interrupt, which would race a task
+ * in the middle of Stepper::move(). Routed to SCT2 as well, the switch has halted the axis in hardware by now anyway
+ */
+template <Stepper::Axis axis>
+void Homing::onSwitch(bool pressed, portBASE_TYPE* const xHigherPriorityWoken) {
+	if (pressed)
+		xSemaphoreGiveFromISR(event, xHigherPriorityWoken);
+}
+
+void Homing::onMoveDone(portBASE_TYPE* const xHigherPriorityWoken) {
+	xSemaphoreGiveFromISR(event, xHigherPriorityWoken);
+}
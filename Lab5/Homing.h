@@ -0,0 +1,60 @@
+/*
+ * Homing.h
+ *
+ * Two-speed homing for G28. Each end is found with a fast ramped approach, a short back-off and a slow approach,
+ * so it's the slow approach that sets the position. Origin (Clockwise) first, then the limit, which gives the travel
+ * in steps, then a ramped move back to the origin. A switch only stops its own axis, so the slow approaches run both
+ * axes together, free-running, and each one drops out once its switch is pressed. The fast approaches are ramped
+ * moves, which a switch ends as a whole, so they take one axis at a time.
+ * The free-running rates are put back as they were afterwards.
+ */
+
+#ifndef HOMING_H_
+#define HOMING_H_
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "DigitalIOPin.h"
+#include "Stepper.h"
+
+class Homing {
+public:
+	/* A null origin switch leaves that axis out */
+	struct Switches {
+		DigitalIOPin* origin;
+		DigitalIOPin* limit;
+	};
+
+	/* Takes over the switches' pin interrupts. Each one wakes the homing task, which halts that axis */
+	Homing(Switches const x, Switches const y);
+	Homing(Homing const &)			= delete;
+	void operator=(Homing const &)	= delete;
+
+	/* Blocks the calling task. False if a switch wasn't found within kMaxTravel steps or timeout ticks of a phase */
+	[[nodiscard]] bool home(TickType_t const timeout = configTICK_RATE_HZ * 30);
+
+	/* Also works as the Stepper::haltOn() callback, if the switches are routed to SCT2 as well */
+	static void onLimit(uint8_t input, portBASE_TYPE* const xHigherPriorityWoken);
+
+private:
+	enum End{ Origin, Limit };
+
+	Switches const switches[2];
+	bool pending[2]{ false };
+
+	[[nodiscard]] bool run(TickType_t const timeout);
+	[[nodiscard]] bool approach(End const end, bool const fast, TickType_t const timeout);
+	[[nodiscard]] bool backOff(End const end, TickType_t const timeout);
+	[[nodiscard]] DigitalIOPin* getSwitch(size_t const axis, End const end) const noexcept;
+
+	template <Stepper::Axis axis>
+	static void onSwitch(bool pressed, portBASE_TYPE* const xHigherPriorityWoken);
+	static void onMoveDone(portBASE_TYPE* const xHigherPriorityWoken);
+
+	static SemaphoreHandle_t event;
+	static constexpr int32_t kMaxTravel{ 100'000 };
+	static constexpr int32_t kBackOffSteps{ 200 };
+	static constexpr size_t kSlowStepsPerSecond{ 200 };
+};
+
+#endif /* HOMING_H_ */
@@ -4,10 +4,15 @@
 #include "semphr.h"
 #include "DigitalIOPin.h"
 #include "Stepper.h"
+#include "Homing.h"
+#include "Telemetry.h"
+#include <algorithm>
 
 #define EX1 1
 #define EX2 0
 #define EX3 0
+#define EX4 0
+#define TELEMETRY 0 // Alongside any of them. Binary frames on the debug UART, for telemetry_main on the host
 
 SemaphoreHandle_t stepper_notify;
 SemaphoreHandle_t io_event;
@@ -31,20 +36,20 @@ int main(void) {
 
 	stepper_notify = xSemaphoreCreateBinary();
 	io_event = xSemaphoreCreateCounting( 7, 0 );
-	limitSW1 = new DigitalIOPin{ { 0, 9 }, true, true, true, PIN_INT0_IRQn };
-	limitSW2 = new DigitalIOPin{ { 0, 29}, true, true, true, PIN_INT1_IRQn };
+	static DigitalIOPin sw1{ { 0, 9 }, true, true, true, PIN_INT0_IRQn }; // Not at file scope, the pins need the board set up first
+	static DigitalIOPin sw2{ { 0, 29}, true, true, true, PIN_INT1_IRQn };
+	limitSW1 = &sw1;
+	limitSW2 = &sw2;
 
 #if EX1 == 1
 
 	xTaskCreate([](void* pvParameters) {
 		limitSW1->setOnIRQCallback([](bool pressed, portBASE_TYPE* xHigherPriorityWoken) {
 			Board_LED_Set(0, pressed);
-			xSemaphoreGiveFromISR(stepper_notify, xHigherPriorityWoken);
 		});
 
 		limitSW2->setOnIRQCallback([](bool pressed, portBASE_TYPE* xHigherPriorityWoken) {
 			Board_LED_Set(1, pressed);
-			xSemaphoreGiveFromISR(stepper_notify, xHigherPriorityWoken);
 		});
 
 		while (true)
@@ -54,12 +59,15 @@ int main(void) {
 
 	xTaskCreate([](void* pvParamters) {
 		auto& stepper = Stepper::getXStepper();
-		constexpr auto callback = [](bool pressed, portBASE_TYPE* const xHigherPriorityWoken) { xSemaphoreGiveFromISR(stepper_notify, xHigherPriorityWoken); };
-		DigitalIOPin button1{ { 0, 8 }, true, true, true, PIN_INT2_IRQn, callback };
-		DigitalIOPin button3{ { 1, 8 }, true, true, true, PIN_INT3_IRQn, callback };
+		DigitalIOPin button1{ { 0, 8 }, true, true, true, PIN_INT2_IRQn };
+		DigitalIOPin button3{ { 1, 8 }, true, true, true, PIN_INT3_IRQn };
+
+		// Every pin wakes this task straight from its interrupt, no semaphore in between
+		for (DigitalIOPin* pin : { limitSW1, limitSW2, &button1, &button3 })
+			pin->notify(xTaskGetCurrentTaskHandle());
 
 		while (true) {
-			xSemaphoreTake(stepper_notify, portMAX_DELAY);
+			xTaskNotifyWait(0, UINT32_MAX, nullptr, portMAX_DELAY);
 
 			if (limitSW1->read() || limitSW2->read()) {
 				stepper.halt();
@@ -195,6 +203,59 @@ int main(void) {
 		}
 	}, "Task 2", configMINIMAL_STACK_SIZE, nullptr, tskIDLE_PRIORITY + 1UL, nullptr);
 
+#elif EX4 == 1
+
+	xTaskCreate([](void* pvParameters) {
+		// The switches also go to SCT2 inputs 0 and 1, through SCT_PIN0/1 which are the first input mux selections,
+		// so they stop X in hardware rather than after a trip through the pin interrupt and a task
+		limitSW1->assign(SWM_SCT_PIN0_I);
+		limitSW2->assign(SWM_SCT_PIN1_I);
+		auto& stepper = Stepper::getXStepper();
+		if (!stepper.haltOn(0, 0, Homing::onLimit) || !stepper.haltOn(1, 1, Homing::onLimit))
+			Board_LED_Set(2, true); // Homing still works off the pin interrupts, only with more overshoot
+
+		Homing homing{ { limitSW1, limitSW2 }, { nullptr, nullptr } }; // What G28 will do, on the one axis we have here
+
+		while (true) {
+			bool const homed = homing.home();
+			Board_LED_Set(homed ? 1 : 0, true);
+			vTaskDelay(homed ? portMAX_DELAY : configTICK_RATE_HZ * 5);
+			Board_LED_Set(0, false);
+		}
+	}, "Task 1", configMINIMAL_STACK_SIZE + 128, nullptr, tskIDLE_PRIORITY + 1UL, nullptr);
+
+#endif
+
+#if TELEMETRY == 1
+
+	// Where the steppers really are against where they were sent. At idle priority, so it only has the time left over
+	xTaskCreate([](void* pvParameters) {
+		TickType_t wake = xTaskGetTickCount();
+		uint8_t sequence{ 0 };
+
+		while (true) {
+			vTaskDelayUntil(&wake, pdMS_TO_TICKS(4)); // 250 Hz, as fast as the frames fit 115200 baud
+
+			Stepper::Position const position = Stepper::getPosition(), target = Stepper::getTarget();
+			Stepper::Progress const progress = Stepper::getProgress();
+
+			Telemetry::Sample sample{};
+			sample.time = static_cast<uint16_t>(wake * portTICK_PERIOD_MS);
+			sample.target_x = static_cast<int32_t>(target.x);
+			sample.target_y = static_cast<int32_t>(target.y);
+			sample.position_x = static_cast<int32_t>(position.x);
+			sample.position_y = static_cast<int32_t>(position.y);
+			sample.planner_depth = static_cast<uint8_t>(progress.lines);
+			sample.step_rate = static_cast<uint16_t>(std::min<uint32_t>(progress.steps_per_second, UINT16_MAX));
+			sample.flags = Telemetry::Sample::Measured; // No command queue here, queue_depth stays 0
+
+			uint8_t frame[Telemetry::kFrameSize];
+			Telemetry::encode(sample, sequence++, frame);
+			for (uint8_t const byte : frame)
+				Board_UARTPutChar(static_cast<char>(byte));
+		}
+	}, "Telemetry", configMINIMAL_STACK_SIZE, nullptr, tskIDLE_PRIORITY, nullptr);
+
 #endif
 
 	vTaskStartScheduler();
@@ -0,0 +1,59 @@
+/*
+ * LineInterpolator.h
+ *
+ * Shares a straight segment's step events out between the two axes. The major axis steps on every event and the
+ * minor one whenever its Bresenham error overflows, so both end exactly on target. Each axis keeps its own sign and
+ * an axis with no travel never steps.
+ * Nothing here touches hardware, so the host tools count the very steps the step interrupt takes.
+ */
+
+#ifndef LINEINTERPOLATOR_H_
+#define LINEINTERPOLATOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+class LineInterpolator {
+public:
+    /* Per axis, -1, 0 or +1 */
+    struct Steps {
+        int8_t x, y;
+    };
+
+    void start(int32_t const dx, int32_t const dy) noexcept {
+        sign[0] = (dx > 0) - (dx < 0);
+        sign[1] = (dy > 0) - (dy < 0);
+        minor[0] = dx < 0 ? -static_cast<uint32_t>(dx) : dx;
+        minor[1] = dy < 0 ? -static_cast<uint32_t>(dy) : dy;
+        major = std::max(minor[0], minor[1]);
+        error[0] = error[1] = major / 2; // Rounds the minor axis steps to the nearest point on the line
+    }
+
+    /* Step events in the segment, max(|dx|, |dy|) */
+    [[nodiscard]] uint32_t events() const noexcept {
+        return major;
+    }
+
+    /* Which axes step on the next event, and which way */
+    [[nodiscard]] Steps next() noexcept {
+        return { advance(0), advance(1) };
+    }
+
+private:
+    uint32_t major{ 0 };
+    uint32_t minor[2]{ 0 };     // |dx|, |dy|
+    uint32_t error[2]{ 0 };
+    int8_t sign[2]{ 0 };
+
+    [[nodiscard]] int8_t advance(size_t const axis) noexcept {
+        error[axis] += minor[axis];
+        if (error[axis] < major)
+            return 0;
+
+        error[axis] -= major;
+        return sign[axis];
+    }
+};
+
+#endif /* LINEINTERPOLATOR_H_ */
@@ -0,0 +1,56 @@
+/*
+ * SeqLock.h
+ *
+ * A value that one writer (e.g. an interrupt) updates and any number of tasks read, without a lock and without
+ * disabling interrupts. The writer makes the sequence odd while it writes and never waits. A reader copies the value
+ * and retries if the sequence was odd or moved meanwhile, so it always gets a value the writer actually stored.
+ * Only worth it for values too wide for one atomic load, like a pair of 64-bit counts on a 32-bit core.
+ */
+
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+template <typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+	SeqLock(T const& value = T{}) : value{ value } {}
+
+	[[nodiscard]] T load() const noexcept {
+		T copy;
+		uint32_t before, after;
+
+		do {
+			before = sequence.load(std::memory_order_acquire);
+			copy = value;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while (before != after || before & 1);
+
+		return copy;
+	}
+
+	/* Writers have to be serialised among themselves, only readers are lock-free */
+	template <typename Update>
+	void update(Update const& update) noexcept {
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		update(value);
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	void store(T const& value) noexcept {
+		update([&value](T& current) { current = value; });
+	}
+
+private:
+	std::atomic<uint32_t> sequence{ 0 };
+	T value;
+};
+
+#endif /* SEQLOCK_H_ */
@@ -6,55 +6,72 @@
  */
 
 #include "Stepper.h"
+#include <algorithm>
+#include <iterator>
 
 bool Stepper::isInit{ false };
+Stepper* Stepper::steppers[2]{ nullptr };
+Stepper::Line Stepper::line{};
+Planner Stepper::planner{ Planner::Ramp<kTickrateHz, kMaxStepsPerSecond, kMinStepsPerSecond, kAcceleration>::kConfig };
+std::atomic<bool> Stepper::moving{ false };
+SeqLock<Stepper::Position> Stepper::position{};
+SeqLock<Stepper::Position> Stepper::target{};
+std::atomic<uint32_t> Stepper::interval{ 0 };
+Stepper::LimitEvent Stepper::limit_events[4]{};
 
 extern "C" {
 void SCT2_IRQHandler(void) {
-	if (LPC_SCT2->EVFLAG & SCT_EVT_0) {
-		Stepper::getXStepper().isr();
-		Chip_SCT_ClearEventFlag(LPC_SCT2, SCT_EVT_0);
-	} else if (LPC_SCT2->EVFLAG & SCT_EVT_1) {
-		Stepper::getYStepper().isr();
-		Chip_SCT_ClearEventFlag(LPC_SCT2, SCT_EVT_1);
-	}
+	portBASE_TYPE xHigherPriorityWoken = pdFALSE;
+	uint32_t const flags = LPC_SCT2->EVFLAG;
+
+	LPC_SCT2->EVFLAG = flags; // Clear everything that's pending up front, and service both counters in this one pass
+	if (flags & SCT_EVT_2)
+		Stepper::tick(Stepper::X_Axis, &xHigherPriorityWoken);
+	if (flags & SCT_EVT_3)
+		Stepper::tick(Stepper::Y_Axis, &xHigherPriorityWoken);
+	if (flags & (SCT_EVT_6 | SCT_EVT_7 | SCT_EVT_8 | SCT_EVT_9))
+		Stepper::limit(flags, &xHigherPriorityWoken); // After the ticks, so the last steps are counted first
+	portEND_SWITCHING_ISR(xHigherPriorityWoken);
 }
 }
 
-Stepper& Stepper::getXStepper() {
-	static Stepper X{ { 0, 24 }, { 1, 0 }, 100, X_Axis };
+Stepper& Stepper::getXStepper(Wiring const& wiring) {
+	static Stepper X{ wiring.step, wiring.direction, 100, X_Axis };
 
 	return X;
 }
 
-Stepper& Stepper::getYStepper() {
-	static Stepper Y{ { 0, 22 }, { 1, 0 }, 100, Y_Axis };
+Stepper& Stepper::getYStepper(Wiring const& wiring) {
+	static Stepper Y{ wiring.step, wiring.direction, 100, Y_Axis };
 
 	return Y;
 }
 
 Stepper::Stepper(LPCPinMap step_pin, LPCPinMap direction_pin, size_t steps_per_second, Axis axis)
-: direction_pin{ direction_pin, false, false, false } {
+: direction_pin{ direction_pin, false, false, false }, axis{ axis } {
 	if (!isInit) {
 		Chip_SCTPWM_Init(LPC_SCT2);
-		LPC_SCT2->CONFIG = 1 << 0 | 1 << 17; 	// Unified timer | auto limit
-		LPC_SCT2->CTRL_U |= (kPrescaler - 1) << 5; 	// Set prescaler. Sysclock / 72 = 1MHz
+		LPC_SCT2->CONFIG = 1 << 17 | 1 << 18; 	// Two 16-bit counters | auto limit on both
 		NVIC_EnableIRQ(SCT2_IRQn);
 		isInit = true;
 	}
 
-	// Leaving the normal PWM stuff here for now, since a Stepper only needs a square wave.
-	LPC_SCT2->MATCHREL[axis].U = kTickrateHz / (steps_per_second * 2) - 1; 			// Number of cycles required to trigger Match N
-	//LPC_SCT2->MATCHREL[axis + 1].U = (kTickrateHz / 2) / steps_per_second - 1; 	// Number of cycles required to trigger Match N + 1
-	LPC_SCT2->EVENT[axis].STATE = 0xFFFFFFFF; 									// States in which Event N will occur
-	//LPC_SCT2->EVENT[axis + 1].STATE = 0xFFFFFFFF; 								// States in which Event N + 1 will occur
-	LPC_SCT2->EVENT[axis].CTRL = axis | 1 << 12; 								// Event N will occur when Match N occurs
-	//LPC_SCT2->EVENT[axis + 1].CTRL = (axis + 1) | 1 << 12; 						// Event N + 1 will occur when Match N + 1 occurs
-	LPC_SCT2->EVEN = 1 << axis;													// Event N will trigger SCT_EVT_N interrupt
-	LPC_SCT2->OUT[axis].SET = 1 << axis; 										// Event N will set SCT2_OUTN pins to high
-	LPC_SCT2->OUT[axis].CLR = 1 << axis;
-	//LPC_SCT2->OUT[axis].CLR = 1 << (axis + 1); 									// Event N + 1 will reset SCT2_OUTN pin to low
-	LPC_SCT2->RES = 3 << axis;
+	stop();
+	control() |= (kPrescaler - 1) << 5; 			// Set prescaler. Sysclock / 72 = 1MHz
+
+	free_running_reload = std::min<size_t>(kTickrateHz / steps_per_second - 1, UINT16_MAX);
+	match(0) = matchReload(0) = free_running_reload; 	// Step period
+	match(1) = matchReload(1) = kPulseTicks; 			// End of the step pulse
+
+	LPC_SCT2->EVENT[kTickEvent[axis]].STATE = 0xFFFFFFFF;
+	LPC_SCT2->EVENT[kTickEvent[axis]].CTRL = 0 | axis << 4 | 1 << 12; 			// Tick event occurs on Match 0 of this counter
+	LPC_SCT2->EVENT[kPulseEndEvent[axis]].STATE = 0xFFFFFFFF;
+	LPC_SCT2->EVENT[kPulseEndEvent[axis]].CTRL = 1 | axis << 4 | 1 << 12; 		// Pulse end event occurs on Match 1 of this counter
+	LPC_SCT2->EVEN |= 1 << kTickEvent[axis]; 									// Only the ticks interrupt
+
+	arm(false); 																// Disarmed until resume() or move()
+	LPC_SCT2->OUT[axis].SET = 1 << axis; 										// Step event N sets SCT2_OUTN high
+	follow(axis);
 
 	if (axis == X_Axis) {
 		Chip_SWM_MovablePortPinAssign(SWM_SCT2_OUT0_O, step_pin.port, step_pin.pin);
@@ -62,15 +79,42 @@ Stepper::Stepper(LPCPinMap step_pin, LPCPinMap direction_pin, size_t steps_per_s
 		Chip_SWM_MovablePortPinAssign(SWM_SCT2_OUT1_O, step_pin.port, step_pin.pin);
 	}
 
+	steppers[axis] = this;
 	setDirection(Clockwise);
 }
 
 void Stepper::resume() noexcept {
-	LPC_SCT2->CTRL_L &= ~(1 << 2);
+	if (moving)
+		return;
+
+	arm(true);
+	start();
 }
 
+/* Only stops this axis, but aborts a move in progress altogether, so the limit switches still stop everything */
 void Stepper::halt() noexcept {
-	LPC_SCT2->CTRL_L |= 1 << 2;
+	NVIC_DisableIRQ(SCT2_IRQn); // finish() empties the planner the interrupt reads
+	if (moving)
+		finish();
+	NVIC_EnableIRQ(SCT2_IRQn);
+
+	stop();
+	arm(false);
+}
+
+void Stepper::setOrigin() {
+	state |= OriginFound;
+
+	NVIC_DisableIRQ(SCT2_IRQn); // Keeps this the only writer for the moment
+	position.update([this](Position& position) { count(position, axis) = 0; });
+	NVIC_EnableIRQ(SCT2_IRQn);
+}
+
+void Stepper::setLimit() {
+	state |= LimitFound;
+
+	Position now = position.load();
+	step_limit = count(now, axis);
 }
 
 [[nodiscard]] Stepper::State Stepper::getState() const noexcept {
@@ -91,19 +135,263 @@ void Stepper::toggleDirection() noexcept {
 
 
 void Stepper::setStepsPerSecond(size_t const steps_per_second) noexcept {
-	LPC_SCT2->MATCHREL[0].U = kTickrateHz / (steps_per_second * 2) - 1;
+	free_running_reload = std::min<size_t>(kTickrateHz / steps_per_second - 1, UINT16_MAX);
+	if (!moving || axis != X_Axis)
+		matchReload(0) = free_running_reload;
+}
+
+[[nodiscard]] size_t Stepper::getStepsPerSecond() const noexcept {
+	return kTickrateHz / (free_running_reload + 1);
+}
+
+[[nodiscard]] bool Stepper::move(int32_t const dx, int32_t const dy, onMoveDoneCallback callback) noexcept {
+	NVIC_DisableIRQ(SCT2_IRQn); // push() replans the lines the interrupt is about to start on
+	bool const queued = planner.push(dx, dy);
+
+	if (queued) {
+		Position const from = moving ? target.load() : position.load(); // From rest the axes may have run free since
+		target.store({ from.x + dx, from.y + dy });
+
+		line.callback = callback;
+		if (!moving)
+			begin();
+	}
+	NVIC_EnableIRQ(SCT2_IRQn);
+	return queued;
+}
+
+[[nodiscard]] bool Stepper::isMoving() noexcept {
+	return moving;
+}
+
+[[nodiscard]] Stepper::Position Stepper::getPosition() noexcept {
+	return position.load();
+}
+
+[[nodiscard]] Stepper::Position Stepper::getTarget() noexcept {
+	return target.load();
+}
+
+[[nodiscard]] Stepper::Progress Stepper::getProgress() noexcept {
+	uint32_t const ticks = interval;
+	return { planner.size(), ticks == 0 ? 0 : static_cast<uint32_t>(kTickrateHz / ticks) };
 }
 
 void Stepper::isr() {
-	switch (getDirection()) {
+	Direction const direction = getDirection();
+	int64_t step_count;
+
+	position.update([this, direction, &step_count](Position& position) {
+		step_count = count(position, axis) += direction == CounterClockwise ? 1 : -1;
+	});
+
+	switch (direction) {
 	case CounterClockwise:
-		if (++step_count >= step_limit - kLimitDelta && state & LimitFound)
+		if (step_count >= step_limit - kLimitDelta && state & LimitFound)
 			toggleDirection();
 		break;
 
 	case Clockwise:
-		if (--step_count <= kLimitDelta && state & OriginFound)
+		if (step_count <= kLimitDelta && state & OriginFound)
 			toggleDirection();
 		break;
 	}
 }
+
+/* Runs once per period of counter, just after the armed axes on it have stepped */
+void Stepper::tick(Axis const counter, portBASE_TYPE* const xHigherPriorityWoken) {
+	if (!moving) {
+		if (steppers[counter] != nullptr)
+			steppers[counter]->isr();
+		return;
+	}
+
+	if (counter != X_Axis)
+		return;
+
+	bool const stepped = line.armed.x != 0 || line.armed.y != 0;
+
+	// Counted by the sign each axis was armed with, never by reading back a direction pin
+	position.update([](Position& position) {
+		position.x += line.armed.x;
+		position.y += line.armed.y;
+	});
+
+	if (advance() || stepped) // One more period with nothing armed after the last step, so its pulse ends on time
+		return;
+
+	finish();
+
+	if (line.callback != nullptr)
+		line.callback(xHigherPriorityWoken);
+}
+
+[[nodiscard]] bool Stepper::haltOn(uint8_t const input, uint8_t const source, onLimitCallback callback) noexcept {
+	Axis const counters[]{ axis, X_Axis };
+	size_t const needed = axis == X_Axis ? 1 : 2;
+	size_t slots[2];
+	size_t found{ 0 };
+
+	if (input >= kLimitInputs || moving)
+		return false;
+
+	for (size_t n = 0; n < std::size(limit_events) && found < needed; ++n)
+		if (limit_events[n].stepper == nullptr)
+			slots[found++] = n;
+	if (found < needed)
+		return false;
+
+	limit_callback = callback;
+	LPC_INMUX->SCT2_INMUX[input] = source;
+
+	for (size_t i = 0; i < needed; ++i) {
+		uint32_t const event = kLimitEvent + slots[i];
+
+		limit_events[slots[i]] = { this, input, counters[i] };
+		LPC_SCT2->EVENT[event].CTRL = input << 6 | counters[i] << 4 | 1 << 10 | 2 << 12; 	// Limit event occurs on a rising edge of the input, in counter's state machine
+		(counters[i] == X_Axis ? LPC_SCT2->HALT_L : LPC_SCT2->HALT_H) |= 1 << event; 	// ...and halts that counter only
+		LPC_SCT2->EVEN |= 1 << event;
+	}
+
+	for (auto stepper : steppers) 	// Nothing's moving, so each axis is on its own counter
+		if (stepper != nullptr)
+			stepper->follow(stepper->axis);
+	return true;
+}
+
+/* The counter has already stopped by the time this runs. Catch the software up with it */
+void Stepper::limit(uint32_t const events, portBASE_TYPE* const xHigherPriorityWoken) {
+	for (size_t n = 0; n < std::size(limit_events); ++n) {
+		Stepper* const stepper = limit_events[n].stepper;
+		if (stepper == nullptr || !(events & 1 << (kLimitEvent + n)))
+			continue;
+
+		if (moving) // Either axis' switch halts the X counter during a move, so the move is over
+			finish();
+		stepper->stop();
+		stepper->arm(false);
+
+		if (stepper->limit_callback != nullptr)
+			stepper->limit_callback(limit_events[n].input, xHigherPriorityWoken);
+	}
+}
+
+void Stepper::arm(bool const step) noexcept {
+	LPC_SCT2->EVENT[axis].STATE = step ? 0xFFFFFFFF : 0;
+}
+
+/* Puts this axis' step pulse on counter's period, its own or the X counter during a move, along with its limit switches */
+void Stepper::follow(Axis const counter) noexcept {
+	LPC_SCT2->EVENT[axis].CTRL = 0 | counter << 4 | 1 << 12; 	// Step event N occurs on Match 0 of counter
+	LPC_SCT2->OUT[axis].CLR = 1 << kPulseEndEvent[counter] | halting(counter); 	// ...and the pulse end event of counter, or anything halting it, sets the pin low again
+
+	for (size_t n = 0; n < std::size(limit_events); ++n) 	// Only this axis' limit event on counter is live
+		if (limit_events[n].stepper == this)
+			LPC_SCT2->EVENT[kLimitEvent + n].STATE = limit_events[n].counter == counter ? 0xFFFFFFFF : 0;
+}
+
+void Stepper::start() noexcept {
+	control() &= ~(1 << 2);
+}
+
+void Stepper::stop() noexcept {
+	control() |= 1 << 2;
+}
+
+[[nodiscard]] volatile uint16_t& Stepper::control() const noexcept {
+	return axis == X_Axis ? LPC_SCT2->CTRL_L : LPC_SCT2->CTRL_H;
+}
+
+[[nodiscard]] volatile uint16_t& Stepper::match(size_t const n) const noexcept {
+	return axis == X_Axis ? LPC_SCT2->MATCH[n].L : LPC_SCT2->MATCH[n].H;
+}
+
+[[nodiscard]] volatile uint16_t& Stepper::matchReload(size_t const n) const noexcept {
+	return axis == X_Axis ? LPC_SCT2->MATCHREL[n].L : LPC_SCT2->MATCHREL[n].H;
+}
+
+/* Starts the X counter from rest on the first step the planner has, with Y following it */
+void Stepper::begin() noexcept {
+	Stepper& x = *steppers[X_Axis];
+	Stepper& y = *steppers[Y_Axis];
+
+	x.stop();
+	y.stop();
+	x.arm(false);
+	y.arm(false);
+
+	line.has_upcoming = planner.step(line.upcoming);
+	if (!line.has_upcoming) // Only ever zero-length lines
+		return;
+
+	y.follow(X_Axis);
+	x.match(0) = reload(line.upcoming.interval); // Its own period. advance() arms it and loads the next one
+	(void) advance();
+	LPC_SCT2->COUNT_L = 0; // First step gets a full period, which also gives the direction pins time to settle
+	moving = true;
+	x.start();
+}
+
+/*
+ * Arms the step that ends the period just started, and loads the reload register with the period after it.
+ * The major axis always steps, the minor one whenever its error overflows. False, with nothing armed, once the planner
+ * has run dry. A line queued after that goes out at the period already loaded, the slow end of the last one.
+ */
+[[nodiscard]] bool Stepper::advance() noexcept {
+	Stepper& x = *steppers[X_Axis];
+	Stepper& y = *steppers[Y_Axis];
+	Planner::Step step = line.upcoming;
+
+	if (!line.has_upcoming && !planner.step(step)) {
+		line.armed = { 0, 0 };
+		x.arm(false);
+		y.arm(false);
+		return false;
+	}
+
+	if (step.index == 0) {
+		if (step.dx != 0)
+			x.setDirection(step.dx < 0 ? Clockwise : CounterClockwise);
+		if (step.dy != 0)
+			y.setDirection(step.dy < 0 ? Clockwise : CounterClockwise);
+		line.interpolator.start(step.dx, step.dy);
+	}
+
+	line.armed = line.interpolator.next();
+	x.arm(line.armed.x != 0);
+	y.arm(line.armed.y != 0);
+	interval = step.interval;
+
+	line.has_upcoming = planner.step(line.upcoming);
+	x.matchReload(0) = reload(line.has_upcoming ? line.upcoming.interval : step.interval);
+	return true;
+}
+
+[[nodiscard]] uint32_t Stepper::halting(Axis const counter) noexcept {
+	return counter == X_Axis ? LPC_SCT2->HALT_L : LPC_SCT2->HALT_H;
+}
+
+[[nodiscard]] int64_t& Stepper::count(Position& position, Axis const axis) noexcept {
+	return axis == X_Axis ? position.x : position.y;
+}
+
+/* Hands the X counter back after a move, whether it finished or not */
+void Stepper::finish() noexcept {
+	Stepper& x = *steppers[X_Axis];
+	Stepper& y = *steppers[Y_Axis];
+
+	x.stop();
+	x.arm(false);
+	y.arm(false);
+	y.follow(Y_Axis);
+	x.match(0) = x.matchReload(0) = x.free_running_reload;
+	planner.clear(); // Anything still queued behind a line that was cut short
+	line.armed = { 0, 0 };
+	line.has_upcoming = false;
+	interval = 0;
+	moving = false;
+}
+
+[[nodiscard]] uint16_t Stepper::reload(uint32_t const interval) noexcept {
+	return std::min<uint32_t>(interval - 1, UINT16_MAX);
+}
@@ -9,56 +9,186 @@
 #define STEPPER_H_
 
 #include "board.h"
+#include "FreeRTOS.h"
 #include "DigitalIOPin.h"
+#include "SeqLock.h"
+#include "LineInterpolator.h"
+#include "Planner.h"
 #include <atomic>
+#include <cstdint>
 #include <utility>
 
+/*
+ * SCT2 runs as two 16-bit counters and each axis owns one: X the L counter, Y the H counter. On its own counter,
+ * match 0 is the step period, with a step event that sets the step pin and a tick event that interrupts, and match 1
+ * clears the pin again to end the pulse. So each axis has its own rate, and a new rate takes effect at the end of the
+ * current period through the match reload register, never mid-pulse.
+ * An axis steps free-running between resume() and halt(). During move() the Y step event follows the X counter instead,
+ * so both axes step off the one tick, and every period comes from the Planner.
+ */
 class Stepper {
 public:
 	enum Direction{ CounterClockwise, Clockwise };
 	enum State{ Unknown = 0, OriginFound = 1, LimitFound = 2 };
 	enum Axis{ X_Axis, Y_Axis };
 
+	/* Steps from the origin, CounterClockwise being positive */
+	struct Position {
+		int64_t x, y;
+	};
+
+	/* The move in progress: lines in the planner, the running one included, and the major axis' rate. Both 0 at rest */
+	struct Progress {
+		size_t lines;
+		uint32_t steps_per_second;
+	};
+
+	/* Where an axis' driver is connected */
+	struct Wiring {
+		LPCPinMap step, direction;
+	};
+
+	static constexpr Wiring kXWiring{ { 0, 24 }, { 1, 0 } };
+	static constexpr Wiring kYWiring{ { 0, 22 }, { 0, 28 } }; // Direction on P0_28 is yet to be checked against the board
+
+	using onMoveDoneCallback = void (*)(portBASE_TYPE* const xHigherPriorityWoken);
+	using onLimitCallback = void (*)(uint8_t input, portBASE_TYPE* const xHigherPriorityWoken);
+
 	Stepper(Stepper const &)		= delete;
 	void operator=(Stepper const &)	= delete;
 
-	static Stepper& getXStepper();
-	static Stepper& getYStepper();
+	/* The first call sets the axis up on wiring, so a board wired differently makes that call itself. Later calls ignore it */
+	static Stepper& getXStepper(Wiring const& wiring = kXWiring);
+	static Stepper& getYStepper(Wiring const& wiring = kYWiring);
 
 	void resume() noexcept;
+	/* Task context only: it masks and unmasks the step interrupt around the planner, which doesn't nest */
 	void halt() noexcept;
 
-	void setOrigin() {
-		state |= OriginFound;
-		step_count = 0;
+	void setOrigin();
+	void setLimit();
+
+	/* Forgets both ends, so free-running doesn't turn around at stale ones while homing */
+	void clearState() {
+		state = Unknown;
 	}
 
-	void setLimit() {
-		state |= LimitFound;
-		step_limit = step_count.load();
+	[[nodiscard]] int32_t getLimit() const noexcept {
+		return step_limit;
 	}
 
+	/*
+	 * Both axes as of the same step, from any task and as often as needed. Never blocks or masks the step interrupt,
+	 * it just retries in the rare case a step lands while it copies. A coordinated move updates both axes at once,
+	 * so the snapshot is always a point the machine actually passed through.
+	 */
+	[[nodiscard]] static Position getPosition() noexcept;
+
+	/* Where the lines queued so far end, the same way. It stays put when a limit switch cuts them short */
+	[[nodiscard]] static Position getTarget() noexcept;
+	[[nodiscard]] static Progress getProgress() noexcept;
+
 	[[nodiscard]] State getState() const noexcept;
 
 	[[nodiscard]] Direction getDirection() const noexcept;
 	void setDirection(Direction const direction) noexcept;
 	void toggleDirection() noexcept;
 
+	/* Takes effect from the next period. Applies to free-running only, move() sets its own rate */
 	void setStepsPerSecond(size_t const steps_per_second) noexcept;
+	[[nodiscard]] size_t getStepsPerSecond() const noexcept;
+
+	/*
+	 * Queues a straight line of dx, dy steps, CounterClockwise being positive. Every period steps the major axis and the
+	 * minor axis follows a LineInterpolator, so the line ends exactly on target. The Planner sets each period: it ramps
+	 * up from rest and back down to it, and carries speed into lines queued behind this one while it runs.
+	 * Free-running axes are halted first. An axis with no travel keeps its direction pin as it was.
+	 * False, and nothing queued, while the planner is full. callback runs in the interrupt once the last step queued
+	 * so far has gone out, and replaces the one given with any earlier line.
+	 */
+	[[nodiscard]] static bool move(int32_t const dx, int32_t const dy, onMoveDoneCallback callback = nullptr) noexcept;
+	[[nodiscard]] static bool isMoving() noexcept;
+
+	/*
+	 * Halts this axis in hardware on a rising edge of SCT2 input (0 to 2), and ends its step pulse in progress.
+	 * source is the input mux selection for it, see DigitalIOPin::assign() for getting a pin there. An event only ever
+	 * halts the counter it belongs to, so X takes one event and Y two: one on its own counter and one on X's, for while
+	 * it follows that during a move. A switch on the Y axis then stops the whole move, a switch on X stops X's moves and
+	 * leaves Y free-running on. There are 4 events to go round.
+	 * There's no task in the way, so the stop comes within a counter tick. callback then runs in the interrupt for
+	 * the bookkeeping, and replaces the one given for any earlier input on this axis. Edge, not level, so an axis can
+	 * still back off a switch that is held down.
+	 * False, and nothing set up, with the input out of range, too few events left or a move in progress.
+	 */
+	[[nodiscard]] bool haltOn(uint8_t const input, uint8_t const source, onLimitCallback callback = nullptr) noexcept;
 
 	void isr();
+	static void tick(Axis const counter, portBASE_TYPE* const xHigherPriorityWoken);
+	static void limit(uint32_t const events, portBASE_TYPE* const xHigherPriorityWoken);
 
 private:
 	Stepper(LPCPinMap step_pin, LPCPinMap direction_pin, size_t steps_per_second, Axis axis);
 
+	/* Who a limit event belongs to, and which counter */
+	struct LimitEvent {
+		Stepper* stepper;
+		uint8_t input;
+		Axis counter;
+	};
+
+	struct Line {
+		LineInterpolator interpolator;
+		LineInterpolator::Steps armed;	// For the period running, with the sign to count them by
+		Planner::Step upcoming;			// The step after that, whose period is in the reload register
+		bool has_upcoming;
+		onMoveDoneCallback callback;
+	};
+
 	DigitalIOPin direction_pin;
-	std::atomic<size_t> step_count{ 0 }, step_limit{ 0 };
+	Axis const axis;
+	std::atomic<int32_t> step_limit{ 0 };
 	uint8_t state{ Unknown };
 
+	uint16_t free_running_reload;
+	onLimitCallback limit_callback{ nullptr };
+
+	void arm(bool const step) noexcept;
+	void follow(Axis const counter) noexcept;
+	void start() noexcept;
+	void stop() noexcept;
+	[[nodiscard]] volatile uint16_t& control() const noexcept;
+	[[nodiscard]] volatile uint16_t& match(size_t const n) const noexcept;
+	[[nodiscard]] volatile uint16_t& matchReload(size_t const n) const noexcept;
+	[[nodiscard]] static uint32_t halting(Axis const counter) noexcept;
+	static void begin() noexcept;
+	[[nodiscard]] static bool advance() noexcept;
+	static void finish() noexcept;
+	[[nodiscard]] static int64_t& count(Position& position, Axis const axis) noexcept;
+	[[nodiscard]] static uint16_t reload(uint32_t const interval) noexcept;
+
 	static bool isInit;
+	static Stepper* steppers[2];
+	static Line line;
+	static Planner planner;
+	static std::atomic<bool> moving;
+	static SeqLock<Position> position; // Only the SCT2 interrupt writes, or a task with it masked
+	static SeqLock<Position> target; // Only move() writes, with the interrupt masked
+	static std::atomic<uint32_t> interval; // Of the period running during a move, timer ticks
+	static LimitEvent limit_events[4];
 	static constexpr size_t kPrescaler{ 72 };
 	static constexpr size_t kTickrateHz{ 72'000'000 / kPrescaler };
-	static constexpr size_t kLimitDelta{ 10 };
+	static constexpr size_t kPulseTicks{ 10 }; // 10us, well over what the drivers need
+	static constexpr size_t kMinStepsPerSecond{ 400 }; // Start and stop without losing steps
+	static constexpr size_t kMaxStepsPerSecond{ 4000 };
+	static constexpr size_t kAcceleration{ 20000 }; // steps/s^2
+	static constexpr int32_t kLimitDelta{ 10 };
+	static constexpr uint32_t kTickEvent[2]{ 2, 3 };		// Per counter, the step events are 0 and 1
+	static constexpr uint32_t kPulseEndEvent[2]{ 4, 5 };
+	static constexpr uint32_t kLimitEvent{ 6 };			// Handed out by haltOn(), 6 to 9
+	static constexpr uint8_t kLimitInputs{ 3 };
+
+	// The slowest planned period is kMinStepsPerSecond along a diagonal, so the major axis at 1/sqrt(2) of it
+	static_assert(kTickrateHz * 3 / (kMinStepsPerSecond * 2) <= UINT16_MAX, "Periods have to fit a 16-bit counter");
 };
 
 #endif /* STEPPER_H_ */
@@ -0,0 +1,129 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Fixed-size binary telemetry frames, sent on the same serial link as the text replies.
+ *
+ * A frame starts with kSync, which is never part of a text reply (they're plain ASCII), so a reader can split the two
+ * streams byte by byte. Then a sequence number, so dropped frames show up, the sample in little-endian order and a
+ * CRC-8 over everything after the sync byte. 26 bytes, so 250 Hz takes 6.5 kB/s, about 56% of a 115200 baud link.
+ * 500 Hz needs a faster link.
+ *
+ * target is what was commanded and position is where the steppers actually are, so the two can be profiled against
+ * each other. A firmware that drives no steppers leaves Measured clear, and only target and queue_depth mean anything.
+ */
+namespace Telemetry {
+constexpr uint8_t kSync{ 0xA5 };
+constexpr size_t kFrameSize{ 26 };
+
+struct Sample {
+    uint16_t time;                      // Milliseconds, wrapping
+    int32_t target_x, target_y;         // Last commanded target. Steps with Measured, otherwise micrometres
+    int32_t position_x, position_y;     // Steps, as counted by the step interrupt
+    uint8_t queue_depth;                // Commands waiting to execute
+    uint8_t planner_depth;              // Lines in the planner, the running one included
+    uint16_t step_rate;                 // Major axis steps per second, 0 at rest
+    uint8_t flags;
+
+    enum Flags : uint8_t {
+        Measured = 1 << 0,              // position, planner_depth and step_rate come from the steppers
+    };
+};
+
+[[nodiscard]] constexpr uint8_t crc8(uint8_t const* data, size_t const length) noexcept {
+    uint8_t crc{ 0 };
+
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 0x80 ? static_cast<uint8_t>(crc << 1 ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
+inline void encode(Sample const& sample, uint8_t const sequence, uint8_t (&frame)[kFrameSize]) noexcept {
+    auto put = [&frame](size_t const offset, uint32_t const value, size_t const bytes) {
+        for (size_t i = 0; i < bytes; ++i)
+            frame[offset + i] = static_cast<uint8_t>(value >> 8 * i);
+    };
+
+    frame[0] = kSync;
+    frame[1] = sequence;
+    put(2, sample.time, 2);
+    put(4, static_cast<uint32_t>(sample.target_x), 4);
+    put(8, static_cast<uint32_t>(sample.target_y), 4);
+    put(12, static_cast<uint32_t>(sample.position_x), 4);
+    put(16, static_cast<uint32_t>(sample.position_y), 4);
+    frame[20] = sample.queue_depth;
+    frame[21] = sample.planner_depth;
+    put(22, sample.step_rate, 2);
+    frame[24] = sample.flags;
+    frame[25] = crc8(frame + 1, kFrameSize - 2);
+}
+
+/*
+ * Splits a received byte stream back into text and frames. onText is called with every byte that isn't part of a
+ * valid frame, onSample with each good frame and its sequence number. A frame that fails its CRC goes to onText,
+ * sync byte included, and the search starts again on the byte after the sync.
+ */
+template <typename OnText, typename OnSample>
+class Decoder {
+public:
+    Decoder(OnText on_text, OnSample on_sample) : on_text{ on_text }, on_sample{ on_sample } {}
+
+    void feed(uint8_t const byte) {
+        if (length == 0) {
+            if (byte == kSync)
+                frame[length++] = byte;
+            else
+                on_text(static_cast<char>(byte));
+            return;
+        }
+
+        frame[length++] = byte;
+        if (length < kFrameSize)
+            return;
+
+        length = 0;
+        if (crc8(frame + 1, kFrameSize - 2) == frame[kFrameSize - 1]) {
+            on_sample(decode(), frame[1]);
+        } else {
+            ++corrupt;
+            on_text(static_cast<char>(frame[0]));
+
+            uint8_t rest[kFrameSize - 1];
+            for (size_t i = 1; i < kFrameSize; ++i)
+                rest[i - 1] = frame[i];
+            for (uint8_t const byte : rest) // A real frame may start inside it
+                feed(byte);
+        }
+    }
+
+    [[nodiscard]] size_t corruptFrames() const noexcept { return corrupt; }
+
+private:
+    OnText on_text;
+    OnSample on_sample;
+    uint8_t frame[kFrameSize]{ 0 };
+    size_t length{ 0 };
+    size_t corrupt{ 0 };
+
+    [[nodiscard]] Sample decode() const noexcept {
+        auto get = [this](size_t const offset, size_t const bytes) {
+            uint32_t value{ 0 };
+            for (size_t i = 0; i < bytes; ++i)
+                value |= static_cast<uint32_t>(frame[offset + i]) << 8 * i;
+            return value;
+        };
+
+        return Sample{ static_cast<uint16_t>(get(2, 2)), static_cast<int32_t>(get(4, 4)), static_cast<int32_t>(get(8, 4)),
+                static_cast<int32_t>(get(12, 4)), static_cast<int32_t>(get(16, 4)), frame[20], frame[21],
+                static_cast<uint16_t>(get(22, 2)), frame[24] };
+    }
+};
+}
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,133 @@
+/*
+ * LogFile.cpp
+ *
+ * Host only. Uses mmap on POSIX and a file mapping on Windows.
+ */
+
+#include "LogFile.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOGFILE_SSE2 1
+#endif
+
+LogFile::LogFile(char const* path) {
+#ifdef _WIN32
+    HANDLE const file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    if (LARGE_INTEGER file_size; GetFileSizeEx(file, &file_size)) {
+        length = static_cast<size_t>(file_size.QuadPart);
+        open = true;
+
+        if (length > 0) {
+            if (HANDLE const map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr); map != nullptr) {
+                mapping = static_cast<char const*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(map); // The view keeps the mapping alive
+            }
+            open = mapping != nullptr;
+        }
+    }
+    CloseHandle(file);
+#else
+    int const fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    if (struct stat st; fstat(fd, &st) == 0) {
+        length = static_cast<size_t>(st.st_size);
+        open = true;
+
+        if (length > 0) {
+            void* const map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, length, MADV_SEQUENTIAL);
+                mapping = static_cast<char const*>(map);
+            }
+            open = mapping != nullptr;
+        }
+    }
+    close(fd); // The mapping keeps the file alive
+#endif
+}
+
+LogFile::~LogFile() {
+    if (mapping == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(const_cast<char*>(mapping), length);
+#endif
+}
+
+[[nodiscard]] bool LogFile::is_open() const noexcept {
+    return open;
+}
+
+[[nodiscard]] char const* LogFile::data() const noexcept {
+    return mapping;
+}
+
+[[nodiscard]] size_t LogFile::size() const noexcept {
+    return mapping != nullptr ? length : 0;
+}
+
+[[nodiscard]] LogFile::Lines LogFile::lines() const noexcept {
+    return Lines{ mapping, size() };
+}
+
+LogFile::Lines::Lines(char const* data, size_t const size) noexcept : cursor{ data }, block{ data }, end{ data + size } {}
+
+/* Hands out the next line without its '\n'. A trailing '\r' is left in place, the parser treats it as a terminator */
+[[nodiscard]] bool LogFile::Lines::next(char const*& line, size_t& length) noexcept {
+    if (cursor == end)
+        return false;
+
+    char const* const newline = nextNewline();
+    line = cursor;
+    length = newline - cursor;
+    cursor = newline == end ? end : newline + 1;
+    return true;
+}
+
+/* Each 16-byte block is compared once and its newline bitmask is kept, so short lines don't rescan the same block */
+[[nodiscard]] char const* LogFile::Lines::nextNewline() noexcept {
+#ifdef LOGFILE_SSE2
+    __m128i const newline = _mm_set1_epi8('\n');
+
+    while (mask == 0 && end - block >= 16) {
+        base = block;
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(block)), newline));
+        block += 16;
+    }
+
+    if (mask != 0) {
+#ifdef _WIN32
+        unsigned long bit;
+        _BitScanForward(&bit, mask);
+#else
+        auto const bit = __builtin_ctz(mask);
+#endif
+        mask &= mask - 1;
+        return base + bit;
+    }
+#endif
+
+    // Whatever is left over is less than one block (or SSE2 isn't available), so let memchr handle it
+    auto const found = static_cast<char const*>(std::memchr(block, '\n', end - block));
+    block = found != nullptr ? found + 1 : end;
+    return found != nullptr ? found : end;
+}
@@ -0,0 +1,47 @@
+/*
+ * LogFile.h
+ *
+ * Host only. Memory-maps an mDraw log and hands out its lines in place, without copying or NUL-terminating them.
+ */
+
+#ifndef LOGFILE_H_
+#define LOGFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+class LogFile {
+public:
+    /* Splits a mapped buffer on '\n'. Uses SSE2 to find line breaks 16 bytes at a time where available */
+    class Lines {
+    public:
+        Lines(char const* data, size_t const size) noexcept;
+        [[nodiscard]] bool next(char const*& line, size_t& length) noexcept;
+
+    private:
+        char const* cursor;
+        char const* block;
+        char const* base{ nullptr };
+        char const* const end;
+        uint32_t mask{ 0 };
+
+        [[nodiscard]] char const* nextNewline() noexcept;
+    };
+
+    LogFile(char const* path);
+    LogFile(LogFile const &) = delete;
+    LogFile(LogFile&&) = delete;
+    ~LogFile();
+
+    [[nodiscard]] bool is_open() const noexcept;
+    [[nodiscard]] char const* data() const noexcept;
+    [[nodiscard]] size_t size() const noexcept;
+    [[nodiscard]] Lines lines() const noexcept;
+
+private:
+    char const* mapping{ nullptr };
+    size_t length{ 0 };
+    bool open{ false };
+};
+
+#endif /* LOGFILE_H_ */
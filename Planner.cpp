@@ -0,0 +1,160 @@
+/*
+ * Planner.cpp
+ *
+ * Speeds are planned along the path (Euclidean steps), as indices into the ramp table, then scaled to the major
+ * axis per step, so the step loop only has to deal with one axis.
+ */
+
+#include "Planner.h"
+#include <algorithm>
+
+Planner::Planner(Config const& config) : config{ config }, top{ config.ramp_length - 1 } {}
+
+[[nodiscard]] bool Planner::push(int32_t const dx, int32_t const dy) noexcept {
+    if (full())
+        return false;
+
+    uint32_t const abs_dx = dx < 0 ? -dx : dx, abs_dy = dy < 0 ? -dy : dy;
+    uint32_t const steps = std::max(abs_dx, abs_dy);
+
+    if (steps == 0)
+        return true;
+
+    Block& block = blocks[head];
+    block.dx = dx;
+    block.dy = dy;
+    block.steps = steps;
+    block.length = std::max(steps, isqrt(static_cast<uint64_t>(abs_dx) * abs_dx + static_cast<uint64_t>(abs_dy) * abs_dy));
+    block.path_per_step = (static_cast<uint64_t>(block.length) << 16) / steps;
+    block.max_entry = 0; // Starting from rest
+
+    if (!empty()) {
+        // Carry speed through the junction in proportion to how straight it is: full speed if colinear, none at 90 degrees or more
+        Block const& before = blocks[previous(head)];
+        int64_t const dot = static_cast<int64_t>(before.dx) * dx + static_cast<int64_t>(before.dy) * dy;
+
+        if (dot > 0)
+            block.max_entry = index(config.max_speed * static_cast<uint64_t>(dot) / (static_cast<uint64_t>(before.length) * block.length));
+    }
+    block.entry = block.max_entry;
+
+    head = next(head);
+    recalculate();
+    return true;
+}
+
+[[nodiscard]] bool Planner::step(Step& step) noexcept {
+    if (!running) {
+        if (empty())
+            return false;
+
+        step_index = 0;
+        running = true;
+    }
+
+    Block const& block = blocks[tail];
+    uint32_t speed = top;
+
+    if (step_index < block.accelerate_until)
+        speed = std::min(top, block.entry + path(block, step_index + 1));
+    else if (step_index >= block.decelerate_after)
+        speed = std::min(top, block.exit + path(block, block.steps - step_index));
+
+    step.interval = static_cast<uint64_t>(config.ramp[speed]) * block.path_per_step >> 16; // Along the major axis
+    step.index = step_index;
+    step.count = block.steps;
+    step.dx = block.dx;
+    step.dy = block.dy;
+
+    if (++step_index == block.steps) {
+        running = false;
+        tail = next(tail);
+    }
+    return true;
+}
+
+void Planner::clear() noexcept {
+    tail = head.load();
+    running = false;
+}
+
+[[nodiscard]] bool Planner::full() const noexcept {
+    return next(head) == tail;
+}
+
+[[nodiscard]] bool Planner::empty() const noexcept {
+    return head == tail;
+}
+
+[[nodiscard]] size_t Planner::size() const noexcept {
+    return (head + kSize - tail) % kSize;
+}
+
+/*
+ * Backward pass so every block can still slow down in time for the ones after it (the newest must be able to stop),
+ * then a forward pass so no block enters faster than the one before it could accelerate to. Over a distance, the
+ * fastest reachable speed is just that many entries further up the ramp. Then every block that hasn't started gets
+ * its trapezoid, so step() never has to work one out
+ */
+void Planner::recalculate() noexcept {
+    size_t const first = running ? next(tail) : tail.load();
+
+    if (first == head)
+        return;
+
+    uint32_t next_entry{ 0 };
+    for (size_t i = previous(head);; i = previous(i)) {
+        Block& block = blocks[i];
+
+        if (i == first && running)
+            block.entry = blocks[tail].exit; // The running block has already committed to this
+        else
+            block.entry = std::min(block.max_entry, next_entry + block.length);
+
+        next_entry = block.entry;
+        if (i == first)
+            break;
+    }
+
+    for (size_t i = first; next(i) != head; i = next(i)) {
+        Block& after = blocks[next(i)];
+        after.entry = std::min(after.entry, blocks[i].entry + blocks[i].length);
+    }
+
+    for (size_t i = first; i != head; i = next(i))
+        prepare(blocks[i], next(i) != head ? blocks[next(i)].entry : 0);
+}
+
+/* Works out where the block stops accelerating and starts decelerating, in major axis steps */
+void Planner::prepare(Block& block, uint32_t const exit) const noexcept {
+    auto const major = [&block](uint64_t const path) {
+        return static_cast<uint32_t>(std::min<uint64_t>(block.steps, path * block.steps / block.length));
+    };
+
+    uint32_t const accelerate = top - block.entry;
+    uint32_t const decelerate = top - exit;
+
+    block.exit = exit;
+    if (static_cast<uint64_t>(accelerate) + decelerate <= block.length) {
+        block.accelerate_until = major(accelerate);
+        block.decelerate_after = block.steps - major(decelerate);
+    } else {
+        // Never reaches max speed, so accelerate until the point where deceleration has to begin
+        int64_t const peak = (static_cast<int64_t>(block.length) + exit - block.entry) / 2;
+        block.accelerate_until = block.decelerate_after = major(std::clamp<int64_t>(peak, 0, block.length));
+    }
+}
+
+/* Ramp index of the fastest entry no faster than speed, v^2 = min^2 + 2ai */
+[[nodiscard]] uint32_t Planner::index(uint64_t const speed) const noexcept {
+    if (speed <= config.min_speed)
+        return 0;
+
+    uint64_t const above = (speed * speed - static_cast<uint64_t>(config.min_speed) * config.min_speed) / (2ULL * config.acceleration);
+    return static_cast<uint32_t>(std::min<uint64_t>(above, top));
+}
+
+/* Steps of path covered by steps major axis steps of block */
+[[nodiscard]] uint32_t Planner::path(Block const& block, uint32_t const steps) noexcept {
+    return static_cast<uint64_t>(steps) * block.path_per_step >> 16;
+}
@@ -0,0 +1,139 @@
+/*
+ * Planner.h
+ *
+ * Look-ahead motion planner. Buffers upcoming line segments (in steps), plans a trapezoidal
+ * velocity profile for each one and carries speed through junctions between nearly colinear segments.
+ *
+ * Nothing here touches hardware: the step timer asks step() for each step event and the
+ * interval to wait before it, so the same code runs on the host against a simulated step clock.
+ * Profiles only change timing, never the number of steps, so every segment still ends exactly on target.
+ *
+ * Speeds are kept as indices into a ramp table worked out at compile time, see Ramp. Accelerating by one step of path
+ * moves one entry up the table, so all the planning is additions and push() does what divisions are left.
+ * step() runs in the step interrupt and costs the same on every step: a multiply, a shift and a table lookup.
+ *
+ * On the target, Stepper::move() pushes and the SCT2 tick steps. The G-code firmware doesn't drive the steppers yet,
+ * so the hop from onG1Received to move() only exists on the host, in sim_main.
+ */
+
+#ifndef PLANNER_H_
+#define PLANNER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+class Planner {
+public:
+    struct Config {
+        uint32_t tick_hz;       // Step timer frequency
+        uint32_t max_speed;     // Path speed, steps/s
+        uint32_t min_speed;     // Speed the motors can start and stop at without ramping, steps/s
+        uint32_t acceleration;  // Path acceleration, steps/s^2
+        uint32_t const* ramp;   // Ramp<>::kIntervals for the same four
+        uint32_t ramp_length;
+    };
+
+    /* Floor of the square root. Also builds the ramp tables at compile time */
+    [[nodiscard]] static constexpr uint32_t isqrt(uint64_t const value) noexcept {
+        uint64_t result{ 0 }, remainder{ value };
+        uint64_t bit = 1ULL << 62;
+
+        while (bit > value)
+            bit >>= 2;
+
+        while (bit != 0) {
+            if (remainder >= result + bit) {
+                remainder -= result + bit;
+                result = (result >> 1) + bit;
+            } else {
+                result >>= 1;
+            }
+            bit >>= 2;
+        }
+        return static_cast<uint32_t>(result);
+    }
+
+    /*
+     * Timer ticks per step for a constant acceleration ramp along the path, generated at compile time. Entry i is
+     * at speed sqrt(min^2 + 2 * acceleration * i), i.e. i steps of path up from MinSpeed, and the last entry is
+     * MaxSpeed. Use kConfig to make the Planner that walks it.
+     */
+    template <uint32_t TickHz, uint32_t MaxSpeed, uint32_t MinSpeed, uint32_t Acceleration>
+    struct Ramp {
+        static_assert(MinSpeed > 0 && MinSpeed <= MaxSpeed && MaxSpeed <= TickHz && Acceleration > 0);
+
+        static constexpr uint32_t kLength{ static_cast<uint32_t>(
+                (static_cast<uint64_t>(MaxSpeed) * MaxSpeed - static_cast<uint64_t>(MinSpeed) * MinSpeed) / (2ULL * Acceleration) + 1) };
+
+        static constexpr std::array<uint32_t, kLength> kIntervals = [] {
+            std::array<uint32_t, kLength> intervals{ 0 };
+            for (uint32_t i = 0; i < kLength; ++i)
+                intervals[i] = TickHz / isqrt(static_cast<uint64_t>(MinSpeed) * MinSpeed + 2ULL * Acceleration * i);
+            return intervals;
+        }();
+
+        static constexpr Config kConfig{ TickHz, MaxSpeed, MinSpeed, Acceleration, kIntervals.data(), kLength };
+    };
+
+    /* One step event along the major axis of the running segment */
+    struct Step {
+        uint32_t interval;  // Timer ticks from the previous step event to this one
+        uint32_t index;     // 0 on the first step of a segment
+        uint32_t count;     // Step events in the segment, max(|dx|, |dy|)
+        int32_t dx, dy;     // The segment, for the line interpolator
+    };
+
+    static constexpr size_t kSize{ 16 };
+
+    Planner(Config const& config);
+
+    /*
+     * Queues a relative move. Returns false (and queues nothing) if the buffer is full.
+     * Replanning touches the blocks that step() is about to start, so on the target push() must run with the step
+     * interrupt masked. The running segment itself is never replanned.
+     */
+    [[nodiscard]] bool push(int32_t const dx, int32_t const dy) noexcept;
+
+    /* Returns false when there's nothing left to do */
+    [[nodiscard]] bool step(Step& step) noexcept;
+
+    /* Drops everything queued, the running segment included, e.g. when a limit switch cuts a move short. Same rules as push() */
+    void clear() noexcept;
+
+    [[nodiscard]] bool full() const noexcept;
+    [[nodiscard]] bool empty() const noexcept;
+    [[nodiscard]] size_t size() const noexcept;
+
+private:
+    /* Speeds are ramp indices. Rising by one per step of path is exactly the configured acceleration */
+    struct Block {
+        int32_t dx, dy;
+        uint32_t steps;             // Major axis step events
+        uint32_t length;            // Euclidean length, steps
+        uint32_t path_per_step;     // length / steps, 16.16 fixed point
+        uint32_t max_entry;
+        uint32_t entry;
+        uint32_t exit;              // The next block's entry, or rest
+        // Trapezoid, in major axis steps. Worked out by push() for every block that isn't running yet
+        uint32_t accelerate_until, decelerate_after;
+    };
+
+    Config const config;
+    uint32_t const top;                         // Ramp index of max_speed
+    Block blocks[kSize];
+    std::atomic<size_t> head{ 0 }, tail{ 0 };   // push() owns head, step() owns tail
+    std::atomic<bool> running{ false };         // The tail block has started and is frozen
+    uint32_t step_index{ 0 };
+
+    void recalculate() noexcept;
+    void prepare(Block& block, uint32_t const exit) const noexcept;
+    [[nodiscard]] uint32_t index(uint64_t const speed) const noexcept;
+
+    [[nodiscard]] static constexpr size_t next(size_t const index) noexcept { return (index + 1) % kSize; }
+    [[nodiscard]] static constexpr size_t previous(size_t const index) noexcept { return (index + kSize - 1) % kSize; }
+    [[nodiscard]] static uint32_t path(Block const& block, uint32_t const steps) noexcept;
+};
+
+#endif /* PLANNER_H_ */
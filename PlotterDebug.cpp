@@ -48,9 +48,9 @@ void PlotterDebug::onM11Received(void) const noexcept {
     print_func(OK);
 }
 
-void PlotterDebug::onG1Received(float x, float y, uint8_t relative) noexcept {
+void PlotterDebug::onG1Received(Coordinate x, Coordinate y, uint8_t relative) noexcept {
     if constexpr (kShowDebug) {
-        snprintf(buffer, 64, "[DEBUG] G1: X%.2f, Y%.2f, Relative %c\r\n", x, y, relative);
+        snprintf(buffer, 64, "[DEBUG] G1: X%ldum, Y%ldum, Relative %d\r\n", static_cast<long>(x.micrometres()), static_cast<long>(y.micrometres()), relative);
         print_func(buffer);
     }
     print_func(OK);
@@ -5,7 +5,7 @@
 #include "GCodeParser.h"
 #include <cstdio>
 
-class PlotterDebug : public PlotterInterface {
+class PlotterDebug final : public PlotterInterface {
     constexpr static bool kShowErrors{ false };
     constexpr static bool kShowDebug{ false };
 
@@ -18,7 +18,7 @@ public:
     void onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) noexcept;
     void onM10Received() const noexcept;
     void onM11Received(void) const noexcept;
-    void onG1Received(float x, float y, uint8_t relative) noexcept;
+    void onG1Received(Coordinate x, Coordinate y, uint8_t relative) noexcept;
     void onG28Received(void) const noexcept;
     void onError(char const* reason) const noexcept;
 
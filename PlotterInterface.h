@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include "Coordinate.h"
 
 struct PlotterInterface {
     constexpr static auto OK = "OK\r\n";
@@ -12,7 +13,7 @@ struct PlotterInterface {
     virtual void onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) = 0;
     virtual void onM10Received() const = 0;
     virtual void onM11Received() const = 0;
-    virtual void onG1Received(float x, float y, uint8_t relative) = 0;
+    virtual void onG1Received(Coordinate x, Coordinate y, uint8_t relative) = 0; // Fixed-point, so handlers stay off soft-float
     virtual void onG28Received() const = 0;
     virtual void onError(char const* reason) const = 0;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "PlotterStats.h"
+#include "GCodeParser.h"
+
+PlotterStats::Counts& PlotterStats::Counts::operator+=(Counts const& other) noexcept {
+    for (int i = 0; i < kCounterCount; ++i)
+        value[i] += other.value[i];
+    return *this;
+}
+
+PlotterStats::PlotterStats(PlotterInterface* plotter) : plotter{ plotter } { }
+
+void PlotterStats::onM1Received(uint8_t pen_position) noexcept {
+    ++tally.value[M1];
+    if (plotter != nullptr)
+        plotter->onM1Received(pen_position);
+}
+
+void PlotterStats::onM2Received(uint8_t pen_up, uint8_t pen_down) noexcept {
+    ++tally.value[M2];
+    if (plotter != nullptr)
+        plotter->onM2Received(pen_up, pen_down);
+}
+
+void PlotterStats::onM4Received(uint8_t laser_power) noexcept {
+    ++tally.value[M4];
+    if (plotter != nullptr)
+        plotter->onM4Received(laser_power);
+}
+
+void PlotterStats::onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) noexcept {
+    ++tally.value[M5];
+    if (plotter != nullptr)
+        plotter->onM5Received(a_step, b_step, height, width, speed);
+}
+
+void PlotterStats::onM10Received() const noexcept {
+    ++tally.value[M10];
+    if (plotter != nullptr)
+        plotter->onM10Received();
+}
+
+void PlotterStats::onM11Received(void) const noexcept {
+    ++tally.value[M11];
+    if (plotter != nullptr)
+        plotter->onM11Received();
+}
+
+void PlotterStats::onG1Received(Coordinate x, Coordinate y, uint8_t relative) noexcept {
+    ++tally.value[G1];
+    if (plotter != nullptr)
+        plotter->onG1Received(x, y, relative);
+}
+
+void PlotterStats::onG28Received(void) const noexcept {
+    ++tally.value[G28];
+    if (plotter != nullptr)
+        plotter->onG28Received();
+}
+
+void PlotterStats::onError(char const* reason) const noexcept {
+    if (reason == GCodeScanner::kMalformedCode)
+        ++tally.value[MalformedCode];
+    else if (reason == GCodeScanner::kUnknownCode)
+        ++tally.value[UnknownCode];
+    else if (reason == GCodeScanner::kNotAGCode)
+        ++tally.value[NotAGCode];
+    else if (reason == GCodeScanner::kUnsupportedCode)
+        ++tally.value[UnsupportedCode];
+    else
+        ++tally.value[OtherError];
+
+    if (plotter != nullptr)
+        plotter->onError(reason);
+}
+
+[[nodiscard]] PlotterStats::Counts const& PlotterStats::counts() const noexcept {
+    return tally;
+}
+
+[[nodiscard]] char const* PlotterStats::name(Counter const counter) noexcept {
+    constexpr static char const* kNames[kCounterCount]{
+        "M1", "M2", "M4", "M5", "M10", "M11", "G1", "G28", "Malformed code", "Unknown code", "Not a GCode", "Unsupported code", "Other error"
+    };
+    return kNames[counter];
+}
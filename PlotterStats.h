@@ -0,0 +1,39 @@
+#ifndef PLOTTERSTATS_H_
+#define PLOTTERSTATS_H_
+
+#include "PlotterInterface.h"
+#include <cstdint>
+
+/* Counts every callback and error reason, then forwards it to the wrapped plotter (if any) */
+class PlotterStats final : public PlotterInterface {
+public:
+    enum Counter { M1, M2, M4, M5, M10, M11, G1, G28, MalformedCode, UnknownCode, NotAGCode, UnsupportedCode, OtherError, kCounterCount };
+
+    struct Counts {
+        uint64_t value[kCounterCount]{ 0 };
+
+        Counts& operator+=(Counts const& other) noexcept;
+        [[nodiscard]] uint64_t operator[](Counter const counter) const noexcept { return value[counter]; }
+    };
+
+    PlotterStats(PlotterInterface* plotter = nullptr);
+
+    void onM1Received(uint8_t pen_position) noexcept;
+    void onM2Received(uint8_t pen_up, uint8_t pen_down) noexcept;
+    void onM4Received(uint8_t laser_power) noexcept;
+    void onM5Received(uint8_t a_step, uint8_t b_step, uint32_t height, uint32_t width, uint8_t speed) noexcept;
+    void onM10Received() const noexcept;
+    void onM11Received(void) const noexcept;
+    void onG1Received(Coordinate x, Coordinate y, uint8_t relative) noexcept;
+    void onG28Received(void) const noexcept;
+    void onError(char const* reason) const noexcept;
+
+    [[nodiscard]] Counts const& counts() const noexcept;
+    [[nodiscard]] static char const* name(Counter const counter) noexcept;
+
+private:
+    PlotterInterface* plotter;
+    mutable Counts tally; // The const callbacks need to count too
+};
+
+#endif /* PLOTTERSTATS_H_ */
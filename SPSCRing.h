@@ -0,0 +1,132 @@
+/*
+ * SPSCRing.h
+ *
+ * Fixed-size ring for exactly one producer and one consumer, e.g. an interrupt handing data to a task.
+ * Neither side ever waits, locks or masks interrupts: the producer only writes head and the consumer only writes tail,
+ * each published with a release store after the items it covers. Both count freely and wrap with a mask, so Capacity
+ * has to be a power of two and every slot is usable.
+ * Blocking is left to the caller, who already has a semaphore or notification for it.
+ */
+
+#ifndef SPSCRING_H_
+#define SPSCRING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+template <typename T, size_t Capacity>
+class SPSCRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    /* Contiguous slots, for filling or draining in place. May be shorter than what's free or waiting, where the ring wraps */
+    struct Span {
+        T* data;
+        size_t size;
+    };
+
+    /* Producer side */
+
+    bool push(T const& item) noexcept {
+        size_t const h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        items[h & kMask] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Pushes as many as fit, up to count, and returns how many that was */
+    size_t push_n(T const* const source, size_t const count) noexcept {
+        size_t const h = head.load(std::memory_order_relaxed);
+        size_t const n = std::min(count, Capacity - (h - tail.load(std::memory_order_acquire)));
+        size_t const first = std::min(n, Capacity - (h & kMask));
+
+        std::copy_n(source, first, &items[h & kMask]);
+        std::copy_n(source + first, n - first, &items[0]);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    /* Free slots to write into directly. Nothing is visible to the consumer until commit() */
+    [[nodiscard]] Span reserve() noexcept {
+        size_t const h = head.load(std::memory_order_relaxed);
+        size_t const free = Capacity - (h - tail.load(std::memory_order_acquire));
+        return { &items[h & kMask], std::min(free, Capacity - (h & kMask)) };
+    }
+
+    void commit(size_t const count) noexcept {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /* Consumer side */
+
+    [[nodiscard]] bool pop(T& item) noexcept {
+        size_t const t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return false;
+
+        item = items[t & kMask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Pops as many as are waiting, up to count, and returns how many that was */
+    size_t pop_n(T* const destination, size_t const count) noexcept {
+        size_t const t = tail.load(std::memory_order_relaxed);
+        size_t const n = std::min(count, head.load(std::memory_order_acquire) - t);
+        size_t const first = std::min(n, Capacity - (t & kMask));
+
+        std::copy_n(&items[t & kMask], first, destination);
+        std::copy_n(&items[0], n - first, destination + first);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    /* Waiting items to read in place, until consume() hands their slots back to the producer */
+    [[nodiscard]] Span peek() noexcept {
+        size_t const t = tail.load(std::memory_order_relaxed);
+        size_t const waiting = head.load(std::memory_order_acquire) - t;
+        return { &items[t & kMask], std::min(waiting, Capacity - (t & kMask)) };
+    }
+
+    /* The index-th waiting item, without taking it. index has to be below size() */
+    [[nodiscard]] T const& at(size_t const index) const noexcept {
+        return items[(tail.load(std::memory_order_relaxed) + index) & kMask];
+    }
+
+    void consume(size_t const count) noexcept {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /* Either side. Exact for the caller's own side, the other may move on straight after */
+
+    [[nodiscard]] size_t size() const noexcept {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    [[nodiscard]] bool full() const noexcept {
+        return size() == Capacity;
+    }
+
+    [[nodiscard]] static constexpr size_t capacity() noexcept {
+        return Capacity;
+    }
+
+private:
+    static constexpr size_t kMask{ Capacity - 1 };
+
+    T items[Capacity];
+    std::atomic<size_t> head{ 0 }; // Next slot to write, producer only
+    std::atomic<size_t> tail{ 0 }; // Next slot to read, consumer only
+};
+
+#endif /* SPSCRING_H_ */
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#include "GCodeParser.h"
+#include "BinaryJob.h"
+#include "Command.h"
+#include "LogFile.h"
+
+/*
+ * Host tool: compiles a G-code file into a binary job (see BinaryJob.h).
+ * The output starts with the "M90" line and ends with the End opcode, so it can be written to the serial port as-is.
+ * Usage: job <input.gcode> <output.bin>
+ */
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.gcode> <output.bin>\n";
+        return 1;
+    }
+
+    LogFile input(argv[1]);
+    if (!input.is_open()) {
+        std::cerr << "Could not open " << argv[1] << '\n';
+        return 1;
+    }
+
+    std::vector<uint8_t> job;
+    size_t errors{ 0 };
+
+    auto write = [&job](uint8_t byte) { job.push_back(byte); };
+    struct Compiler : BinaryJob::Encoder<decltype(write)> {
+        using Encoder::Encoder;
+        size_t* errors;
+        void onError(char const*) { ++*errors; } // Lines the firmware would reject are left out of the job
+    } compiler{ write };
+    compiler.errors = &errors;
+
+    // Also decode the text straight into Commands, so the binary job can be checked against it below
+    std::vector<Command> expected, decoded;
+    auto expect = CommandEncoder{ [&expected](Command const& command) { expected.push_back(command); } };
+    GCodeParser parser(&compiler);
+    GCodeParser reference(&expect);
+
+    char const* line;
+    size_t length, line_count{ 0 };
+    for (auto lines = input.lines(); lines.next(line, length); ++line_count) {
+        parser.parse(line, length);
+        reference.parse(line, length);
+    }
+    compiler.end();
+
+    auto decode = CommandEncoder{ [&decoded](Command const& command) { decoded.push_back(command); } };
+    BinaryJob::Decoder decoder(&decode);
+    decoder.reset();
+    bool const ended = !decoder.feed(job.data(), job.size());
+
+    auto const isError = [](Command const& command) { return command.tag == Command::Error; };
+    expected.erase(std::remove_if(expected.begin(), expected.end(), isError), expected.end());
+
+    if (!ended || decoded != expected) {
+        std::cerr << "Decoded job does not match " << argv[1] << '\n';
+        return 1;
+    }
+
+    std::ofstream output(argv[2], std::ios::binary);
+    output << "M90\n";
+    output.write(reinterpret_cast<char const*>(job.data()), job.size());
+
+    if (!output) {
+        std::cerr << "Could not write " << argv[2] << '\n';
+        return 1;
+    }
+
+    std::cerr << line_count << " lines, " << decoded.size() << " commands, " << errors << " skipped. "
+            << input.size() << " bytes of text -> " << job.size() << " bytes of job ("
+            << (input.size() > 0 ? 100.0 * job.size() / input.size() : 0) << "%)\n";
+}
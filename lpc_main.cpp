@@ -2,34 +2,161 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "heap_lock_monitor.h"
-#include <array>
 
+#include "FreeRTOS/Queue.h"
+#include "FreeRTOS/Task.h"
+#include "FreeRTOS/Mutex.h"
+#include "FreeRTOS/UART.h"
 #include "GCodeParser.h"
 #include "PlotterDebug.h"
+#include "Command.h"
+#include "BinaryJob.h"
+#include "Telemetry.h"
+#include <atomic>
+#include <mutex>
+
+static_assert(configSUPPORT_STATIC_ALLOCATION, "lpc_main needs configSUPPORT_STATIC_ALLOCATION set to 1 in FreeRTOSConfig.h");
+
+using CommandQueue = FreeRTOS::QueueStatic<Command, 16>;
+
+/* Binary frames on the reply line would confuse a host that doesn't expect them, so this is opt-in */
+constexpr bool kTelemetry{ false };
+constexpr TickType_t kTelemetryPeriod{ pdMS_TO_TICKS(4) }; // 250 Hz, as fast as the frames fit 115200 baud
+
+/* What the tasks share. The telemetry task only ever reads it */
+struct Shared {
+    CommandQueue commands;
+    std::atomic<int32_t> target_x{ 0 }, target_y{ 0 }; // Last executed G1 target, micrometres
+};
+
+/* The debug UART, taken over from the board library so reads can block on its interrupt. First call after Board_Init() */
+static FreeRTOS::UART& serial() {
+    static FreeRTOS::UART uart({ LPC_USART0, 115200, UART_CFG_DATALEN_8 | UART_CFG_PARITY_NONE | UART_CFG_STOPLEN_1, false, { 0, 18 }, { 0, 13 } });
+    return uart;
+}
+
+/* Replies and telemetry frames each go out whole, never interleaved */
+static FreeRTOS::MutexStatic output;
+
+static void print(char const* buffer) {
+    std::lock_guard<FreeRTOS::Mutex> lock(output);
+    serial().write(buffer);
+}
+
+/* Nothing is allocated from the heap, the kernel's own tasks included */
+extern "C" {
+void vApplicationGetIdleTaskMemory(StaticTask_t** control, StackType_t** stack, uint32_t* stack_size) {
+    static StaticTask_t idle_control;
+    static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+    *control = &idle_control;
+    *stack = idle_stack;
+    *stack_size = configMINIMAL_STACK_SIZE;
+}
+
+#if configUSE_TIMERS
+void vApplicationGetTimerTaskMemory(StaticTask_t** control, StackType_t** stack, uint32_t* stack_size) {
+    static StaticTask_t timer_control;
+    static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+    *control = &timer_control;
+    *stack = timer_stack;
+    *stack_size = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+}
 
 int main(void) {
     SystemCoreClockUpdate();
     Board_Init();
     heap_monitor_setup();
+    serial();
+
+    static Shared shared;
+
+    /*
+     * Receives and parses only. A slow move never holds up the next line, unless the queue has filled up.
+     * Sleeps in read() until a line end, a full buffer or a pause, so it wakes about twice a line rather than per byte.
+     */
+    static FreeRTOS::Task<configMINIMAL_STACK_SIZE + 128> receiver([](Shared* shared) {
+        auto enqueue = [commands = &shared->commands](Command const& command) { commands->push_back(command, portMAX_DELAY); };
+
+        // M90 switches the input over to a binary job until its End opcode, see BinaryJob.h
+        struct Receiver : CommandEncoder<decltype(enqueue)> {
+            using CommandEncoder::CommandEncoder;
+            bool binary{ false };
+            void onM90Received() { binary = true; }
+        } receiver{ enqueue };
 
-    xTaskCreate([](auto) {
-        PlotterDebug plotter([](auto buffer) { Board_UARTPutSTR(buffer); });
-        GCodeParser parser(&plotter);
-        std::array<char, 64> buffer;
-        auto count = buffer.begin();
+        GCodeParser parser(&receiver);
+        BinaryJob::Decoder decoder(&receiver);
+
+        char buffer[64];
+        serial().notify(xTaskGetCurrentTaskHandle()); // The only reader. Replies come from two tasks, so they keep the semaphore
 
         while (true) {
-            if (int in = Board_UARTGetChar(); in != EOF) {
-                *count++ = in;
+            int const count = serial().read(buffer, sizeof(buffer), portMAX_DELAY);
+
+            if (count == FreeRTOS::UART::kLost) { // Never run a line or a job with bytes missing from it
+                if (receiver.binary) {
+                    receiver.onError(GCodeScanner::kMalformedCode);
+                    receiver.binary = false;
+                }
+                parser.skipLine();
+                continue;
+            }
 
-                if (in == '\n' || in =='\r' || count == buffer.end()) {
-                    *--count = '\0';
-                    parser.parse(buffer.data());
-                    count = buffer.begin();
+            for (int i = 0; i < count; ++i) {
+                if (!receiver.binary) {
+                    parser.feed(buffer[i]); // Callback fires as soon as the CR/LF arrives, no line buffer needed
+                    if (receiver.binary)
+                        decoder.reset();
+                } else {
+                    receiver.binary = decoder.feed(buffer[i]);
                 }
             }
         }
-    }, "vTaskUart", configMINIMAL_STACK_SIZE + 128, nullptr, tskIDLE_PRIORITY + 1UL, nullptr);
+    }, &shared, "vTaskUart", tskIDLE_PRIORITY + 2UL);
+
+    /* Executes commands in the order they were received. The plotter sends the replies once each command is done */
+    static FreeRTOS::Task<configMINIMAL_STACK_SIZE + 128> executor([](Shared* shared) {
+        PlotterDebug plotter(print);
+
+        while (true) {
+            Command const command = shared->commands.pop_back();
+            command.execute(plotter);
+
+            if (command.tag == Command::G1) {
+                shared->target_x = command.g1.relative ? shared->target_x + command.g1.x : command.g1.x;
+                shared->target_y = command.g1.relative ? shared->target_y + command.g1.y : command.g1.y;
+            }
+        }
+    }, &shared, "vTaskExecutor", tskIDLE_PRIORITY + 3UL);
+
+    /* Samples at a fixed rate. Lowest priority, so it only ever gets the time the G-code path leaves over */
+    if constexpr (kTelemetry) {
+        static_assert(Telemetry::kFrameSize <= FreeRTOS::UART::kMaxReserve, "reserve() would refuse the frame");
+
+        static FreeRTOS::Task<configMINIMAL_STACK_SIZE> telemetry([](Shared* shared) {
+            TickType_t wake = xTaskGetTickCount();
+            uint8_t sequence{ 0 };
+
+            while (true) {
+                vTaskDelayUntil(&wake, kTelemetryPeriod);
+
+                // No steppers here, so nothing Measured: the target is all there is to report
+                Telemetry::Sample sample{};
+                sample.time = static_cast<uint16_t>(wake * portTICK_PERIOD_MS);
+                sample.target_x = shared->target_x;
+                sample.target_y = shared->target_y;
+                sample.queue_depth = static_cast<uint8_t>(shared->commands.size());
+
+                // Encoded straight into the transmit buffer, and the task is back asleep before the frame has gone out
+                std::lock_guard<FreeRTOS::Mutex> lock(output);
+                auto& frame = *reinterpret_cast<uint8_t(*)[Telemetry::kFrameSize]>(serial().reserve(Telemetry::kFrameSize));
+                Telemetry::encode(sample, sequence++, frame);
+                serial().commit(Telemetry::kFrameSize);
+            }
+        }, &shared, "vTaskTelemetry", tskIDLE_PRIORITY + 1UL);
+    }
 
     vTaskStartScheduler();
 
@@ -1,17 +1,240 @@
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <algorithm>
 #include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iterator>
 
 #include "GCodeParser.h"
 #include "PlotterDebug.h"
+#include "PlotterStats.h"
+#include "LogFile.h"
 
-int main() {
-    PlotterDebug plotter([](auto buffer) { std::cout << buffer; });
-    GCodeParser parser(&plotter);
-    std::ifstream infile("log01.txt");
-    std::string buffer;
+struct Replay {
+    bool opened{ false };
+    size_t lines{ 0 }, bytes{ 0 };
+    double seconds{ 0 };
+    PlotterStats::Counts counts;
+};
 
-    if (infile.is_open())
-        while (std::getline(infile, buffer))
-            parser.parse(buffer.c_str());
+/* Runs one log through its own parser and plotter. Safe to call from several threads at once */
+static Replay replay(char const* path, void (*print_func)(char const*)) {
+    PlotterDebug plotter(print_func);
+    PlotterStats stats(&plotter);
+    GCodeParser parser(&stats);
+    Replay result;
+
+    auto const start = std::chrono::steady_clock::now();
+    LogFile log(path);
+
+    if ((result.opened = log.is_open())) {
+        // Lines are parsed in place straight out of the mapping, nothing is copied
+        char const* line;
+        size_t length;
+        for (auto lines = log.lines(); lines.next(line, length); ++result.lines)
+            parser.parse(line, length);
+        result.bytes = log.size();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.counts = stats.counts();
+    return result;
+}
+
+static void printTiming(Replay const& result, double const seconds) {
+    std::cerr << result.lines << " lines, " << result.bytes << " bytes in " << seconds * 1e3 << " ms, "
+            << (result.lines > 0 ? seconds * 1e9 / result.lines : 0) << " ns/line, "
+            << (seconds > 0 ? result.lines / seconds : 0) << " lines/s, "
+            << (seconds > 0 ? result.bytes / seconds / 1e6 : 0) << " MB/s\n";
+}
+
+/* Directories are searched recursively, "@list.txt" reads one path per line */
+static void collect(std::string const& argument, std::vector<std::string>& paths) {
+    namespace fs = std::filesystem;
+
+    if (argument.size() > 1 && argument[0] == '@') {
+        std::ifstream list(argument.substr(1));
+        for (std::string path; std::getline(list, path);)
+            if (!path.empty())
+                paths.push_back(path);
+    } else if (std::error_code ec; fs::is_directory(argument, ec)) {
+        std::vector<std::string> found;
+        for (auto const& entry : fs::recursive_directory_iterator(argument, ec))
+            if (entry.is_regular_file(ec))
+                found.push_back(entry.path().string());
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+    } else {
+        paths.push_back(argument);
+    }
+}
+
+/* Shards the logs across a pool of workers, each with its own parser and plotter, then merges the results into one report */
+static int batch(std::vector<std::string> const& paths, unsigned workers) {
+    std::vector<Replay> results(paths.size());
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> pool;
+
+    workers = std::max(1u, std::min<unsigned>(workers, paths.size()));
+
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < workers; ++i)
+        pool.emplace_back([&] {
+            // Files vary a lot in size, so hand them out one at a time rather than in fixed slices
+            for (size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < paths.size();)
+                results[index] = replay(paths[index].c_str(), [](auto) {});
+        });
+    for (auto& worker : pool)
+        worker.join();
+    auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Replay total;
+    size_t failed{ 0 };
+    double busy{ 0 };
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        auto const& result = results[i];
+        auto const errors = result.counts[PlotterStats::MalformedCode] + result.counts[PlotterStats::UnknownCode]
+                + result.counts[PlotterStats::NotAGCode] + result.counts[PlotterStats::UnsupportedCode]
+                + result.counts[PlotterStats::OtherError];
+
+        if (!result.opened) {
+            std::cout << paths[i] << ": could not open\n";
+            ++failed;
+            continue;
+        }
+
+        std::cout << paths[i] << ": " << result.lines << " lines, " << result.seconds * 1e3 << " ms, " << errors << " errors\n";
+        total.lines += result.lines;
+        total.bytes += result.bytes;
+        total.counts += result.counts;
+        busy += result.seconds;
+    }
+
+    std::cout << "\n" << paths.size() - failed << " of " << paths.size() << " files replayed on " << workers << " threads\n";
+    for (int counter = 0; counter < PlotterStats::kCounterCount; ++counter)
+        std::cout << "  " << PlotterStats::name(static_cast<PlotterStats::Counter>(counter)) << ": "
+                << total.counts[static_cast<PlotterStats::Counter>(counter)] << "\n";
+    std::cout << "  Worker time: " << busy * 1e3 << " ms\n";
+    printTiming(total, elapsed);
+
+    return failed == 0 ? 0 : 1;
+}
+
+/* One line each, with the callback or error it has to end up in */
+struct Expectation {
+    char const* line;
+    PlotterStats::Counter counter;
+};
+
+constexpr Expectation kExpectations[]{
+    { "G1 X12.5 Y-3 A0", PlotterStats::G1 },
+    { "G1 X2000000 Y-2000000 A0", PlotterStats::G1 },
+    { "G1 X2000000.001 Y0 A0", PlotterStats::MalformedCode },
+    { "G1 X3000000 Y0 A0", PlotterStats::MalformedCode },
+    { "G1 X2147.483647 Y0 A0", PlotterStats::G1 },
+    { "G1 X-2147483.647 Y0 A0", PlotterStats::MalformedCode },
+    { "G1 X0.0000005 Y0.0000004 A0", PlotterStats::G1 },
+    { "M1 90", PlotterStats::M1 },
+    { "M1 300", PlotterStats::MalformedCode },
+    { "G28", PlotterStats::G28 },
+    { "G1 X1.2.3 Y4 A0", PlotterStats::MalformedCode },
+    { "G1 X1-2 Y4 A0", PlotterStats::MalformedCode },
+    { "G1-2 X1 Y4 A0", PlotterStats::MalformedCode },
+    { "G1X1Y4A0", PlotterStats::G1 },
+    { "G1 X1 Y4 A0 ; comment", PlotterStats::G1 },
+    { "G28 X", PlotterStats::MalformedCode },
+    { "G1 X Y4 A0", PlotterStats::MalformedCode },
+    { "G1 X1 Y4 A0.9", PlotterStats::MalformedCode },
+    { "G1 X1 Y4 A1.0", PlotterStats::G1 },
+    { "M1 90.5", PlotterStats::MalformedCode },
+    { "M2 U150 D90.1", PlotterStats::MalformedCode },
+    { "M4 -1", PlotterStats::MalformedCode },
+};
+
+/* Runs every line of kExpectations through its own parser, so a failure can't leak into the next line */
+static int selfTest() {
+    size_t failures{ 0 };
+
+    for (auto const& expectation : kExpectations) {
+        PlotterStats stats;
+        GCodeParser parser(&stats);
+        parser.parse(expectation.line);
+
+        if (stats.counts()[expectation.counter] != 1) {
+            std::cerr << "FAILED: \"" << expectation.line << "\" isn't " << PlotterStats::name(expectation.counter) << '\n';
+            ++failures;
+        }
+    }
+
+    // Bytes lost mid-line, then between lines: either way the damaged line is reported and the next whole one runs
+    for (char const* before : { "G1 X1", "" }) {
+        PlotterStats stats;
+        GCodeParser parser(&stats);
+        parser.feed(before, std::strlen(before));
+        parser.skipLine();
+        parser.parse("2 Y4 A0");
+        parser.parse("G28");
+
+        if (stats.counts()[PlotterStats::G1] != 0 || stats.counts()[PlotterStats::G28] != 1
+                || stats.counts()[PlotterStats::MalformedCode] + stats.counts()[PlotterStats::NotAGCode] != 1) {
+            std::cerr << "FAILED: skipLine() after \"" << before << "\"\n";
+            ++failures;
+        }
+    }
+
+    std::cout << (failures == 0 ? "PASSED" : "FAILED") << ": " << std::size(kExpectations) << " lines, " << failures << " failures\n";
+    return failures == 0 ? 0 : 1;
+}
+
+/*
+ * Usage: main -t
+ *        main [-q] [log file]
+ *        main [-j threads] <log file | directory | @list.txt>...
+ * -t checks the parser against kExpectations. A single log is replayed with replies on stdout (unless -q).
+ * Anything more is replayed in parallel and summarised.
+ */
+int main(int argc, char* argv[]) {
+    bool quiet{ false };
+    unsigned workers{ std::thread::hardware_concurrency() };
+    std::vector<std::string> arguments, paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0)
+            return selfTest();
+        else if (std::strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            workers = std::atoi(argv[++i]);
+        else
+            arguments.push_back(argv[i]);
+    }
+
+    if (arguments.empty())
+        arguments.push_back("log01.txt");
+
+    for (auto const& argument : arguments)
+        collect(argument, paths);
+
+    if (paths.size() != 1 || arguments[0] != paths[0])
+        return batch(paths, workers);
+
+    void (*print_func)(char const*) = [](auto) {};
+    if (!quiet)
+        print_func = [](auto buffer) { std::cout << buffer; };
+
+    auto const result = replay(paths[0].c_str(), print_func);
+
+    if (!result.opened) {
+        std::cerr << "Could not open " << paths[0] << '\n';
+        return 1;
+    }
+
+    printTiming(result, result.seconds);
 }
@@ -0,0 +1,184 @@
+#include <iostream>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+
+#include "SPSCRing.h"
+
+/*
+ * Host tool: checks SPSCRing, then streams through it between two real threads and compares the throughput with a
+ * mutex-guarded deque, the nearest host stand-in for a kernel queue.
+ * Every path is exercised across the wrap: push/pop, push_n/pop_n and reserve/commit against peek/consume.
+ * Usage: ring [items]
+ */
+static size_t failures{ 0 };
+
+static void check(bool const condition, char const* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+static void single() {
+    SPSCRing<uint32_t, 8> ring;
+    uint32_t value{ 0 }, buffer[16];
+
+    check(ring.empty() && ring.capacity() == 8 && !ring.pop(value), "starts empty");
+
+    for (uint32_t i = 0; i < 8; ++i)
+        check(ring.push(i), "push into free slots");
+    check(ring.full() && !ring.push(8), "every slot is usable and no more");
+
+    check(ring.pop(value) && value == 0 && ring.size() == 7, "pop oldest first");
+    check(ring.at(0) == 1 && ring.at(6) == 7, "at() without taking");
+
+    // Drain to 5 waiting, then wrap with a bulk push that only partly fits
+    check(ring.pop_n(buffer, 2) == 2 && buffer[0] == 1 && buffer[1] == 2, "pop_n");
+    uint32_t const more[]{ 8, 9, 10, 11, 12 };
+    check(ring.push_n(more, 5) == 3 && ring.full(), "push_n stops when full");
+
+    check(ring.pop_n(buffer, 16) == 8, "pop_n stops when empty");
+    for (uint32_t i = 0; i < 8; ++i)
+        check(buffer[i] == i + 3, "pop_n across the wrap keeps order");
+
+    // Head and tail are now at 11: a reservation only reaches the end of the storage
+    auto span = ring.reserve();
+    check(span.size == 5, "reserve stops at the wrap");
+    for (size_t i = 0; i < span.size; ++i)
+        span.data[i] = 100 + i;
+    check(ring.empty(), "nothing visible before commit");
+    ring.commit(span.size);
+    span = ring.reserve();
+    check(span.size == 3, "then continues from the start");
+    span.data[0] = 105;
+    ring.commit(1);
+
+    auto waiting = ring.peek();
+    check(waiting.size == 5 && waiting.data[0] == 100, "peek stops at the wrap");
+    ring.consume(waiting.size);
+    waiting = ring.peek();
+    check(waiting.size == 1 && waiting.data[0] == 105 && ring.size() == 1, "then continues from the start");
+    ring.consume(1);
+    check(ring.empty(), "consume hands the slots back");
+}
+
+/*
+ * Producer and consumer each cycle through all three ways in, and out, so every pairing meets across the wrap.
+ * Both yield whenever they can't make progress, so this also runs on a single core.
+ */
+static double threaded(uint64_t const count) {
+    static SPSCRing<uint64_t, 1024> ring;
+    bool ordered{ true };
+    auto const start = std::chrono::steady_clock::now();
+
+    std::thread producer([count] {
+        uint64_t next{ 0 }, batch[37];
+        for (unsigned round = 0; next < count; ++round) {
+            if (ring.full())
+                std::this_thread::yield();
+
+            switch (round % 3) {
+            case 0:
+                if (ring.push(next))
+                    ++next;
+                break;
+            case 1: {
+                size_t const n = std::min<uint64_t>(37, count - next);
+                for (size_t i = 0; i < n; ++i)
+                    batch[i] = next + i;
+                next += ring.push_n(batch, n);
+                break;
+            }
+            default: {
+                auto const span = ring.reserve();
+                size_t const n = std::min<uint64_t>(span.size, count - next);
+                for (size_t i = 0; i < n; ++i)
+                    span.data[i] = next + i;
+                ring.commit(n);
+                next += n;
+            }
+            }
+        }
+    });
+
+    uint64_t expected{ 0 }, batch[29], value;
+    for (unsigned round = 0; expected < count; ++round) {
+        if (ring.empty())
+            std::this_thread::yield();
+
+        switch (round % 3) {
+        case 0:
+            if (ring.pop(value))
+                ordered &= value == expected++;
+            break;
+        case 1: {
+            size_t const n = ring.pop_n(batch, 29);
+            for (size_t i = 0; i < n; ++i)
+                ordered &= batch[i] == expected++;
+            break;
+        }
+        default: {
+            auto const span = ring.peek();
+            for (size_t i = 0; i < span.size; ++i)
+                ordered &= span.data[i] == expected++;
+            ring.consume(span.size);
+        }
+        }
+    }
+
+    producer.join();
+    check(ordered && ring.empty(), "two threads: every item arrives once and in order");
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double locked(uint64_t const count) {
+    std::deque<uint64_t> queue;
+    std::mutex mutex;
+    auto const start = std::chrono::steady_clock::now();
+
+    std::thread producer([&] {
+        for (uint64_t next = 0; next < count;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (queue.size() < 1024) {
+                queue.push_back(next++);
+            } else {
+                lock.unlock();
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (uint64_t expected = 0; expected < count;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!queue.empty()) {
+            check(queue.front() == expected++, "locked baseline in order");
+            queue.pop_front();
+        } else {
+            lock.unlock();
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t const count = argc == 2 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+
+    single();
+    double const ring_seconds = threaded(count);
+    double const locked_seconds = locked(count);
+
+    std::cerr << count << " items. SPSCRing " << ring_seconds * 1e9 / count << " ns/item, mutex + deque "
+            << locked_seconds * 1e9 / count << " ns/item\n";
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstdlib>
+#include <utility>
+
+#include "GCodeParser.h"
+#include "Planner.h"
+#include "LineInterpolator.h"
+#include "LogFile.h"
+
+/*
+ * Host tool: runs the G1 moves of a G-code file through the Planner against a simulated step clock,
+ * and compares the plot time with stepping every move at the start/stop speed, as the firmware does without planning.
+ * Checks the LineInterpolator the step interrupt uses first, on every sign combination and single-axis lines.
+ * Usage: sim <input.gcode> [steps per mm]
+ */
+static bool checkLine(int32_t const dx, int32_t const dy) {
+    LineInterpolator line;
+    int32_t x{ 0 }, y{ 0 };
+    bool ok{ true };
+
+    line.start(dx, dy);
+    for (uint32_t i = 0; i < line.events(); ++i) {
+        auto const steps = line.next();
+        ok &= steps.x * dx >= 0 && steps.y * dy >= 0;  // Never against the line, and never on an axis that has no travel
+        ok &= std::abs(dx) >= std::abs(dy) ? steps.x != 0 : steps.y != 0; // The major axis steps on every event
+        x += steps.x;
+        y += steps.y;
+    }
+
+    if (!ok || x != dx || y != dy)
+        std::cerr << "LineInterpolator: line " << dx << ',' << dy << " ended at " << x << ',' << y << (ok ? "\n" : ", stepping the wrong way\n");
+    return ok && x == dx && y == dy;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.gcode> [steps per mm]\n";
+        return 1;
+    }
+
+    bool lines{ true };
+    for (int32_t const d : { 1, 7, 1000 }) {
+        for (auto const& [dx, dy] : { std::pair{ -d, 0 }, { d, 0 }, { 0, -d }, { 0, d }, { d, d }, { -d, d }, { d, -d }, { -d, -d },
+                { -d, 3 }, { 3, -d }, { -d, -d / 3 }, { d / 3, -d } })
+            lines &= checkLine(dx, dy);
+    }
+    if (!lines)
+        return 1;
+
+    LogFile input(argv[1]);
+    if (!input.is_open()) {
+        std::cerr << "Could not open " << argv[1] << '\n';
+        return 1;
+    }
+
+    int32_t const steps_per_mm = argc == 3 ? std::atoi(argv[2]) : 80;
+    Planner::Config const& config = Planner::Ramp<1000000, 4000, 500, 20000>::kConfig;
+    Planner planner(config);
+
+    uint64_t ticks{ 0 }, baseline_ticks{ 0 }, step_events{ 0 }, segments{ 0 };
+    int64_t x_steps{ 0 }, y_steps{ 0 };
+    Planner::Step step;
+    LineInterpolator interpolator;
+
+    // Every step event goes through the interpolator and each axis is counted on its own, as the step interrupt does,
+    // so a profile that drops or adds a step event, or starts a segment early, ends off target
+    auto const run = [&](bool const drain) {
+        while ((drain || planner.full()) && planner.step(step)) {
+            ticks += step.interval;
+            ++step_events;
+            if (step.index == 0)
+                interpolator.start(step.dx, step.dy);
+
+            auto const steps = interpolator.next();
+            x_steps += steps.x;
+            y_steps += steps.y;
+        }
+    };
+
+    struct Mover {
+        Planner* planner;
+        Planner::Config const* config;
+        decltype(run)* drain;
+        int32_t steps_per_mm;
+        uint64_t* baseline_ticks;
+        uint64_t* segments;
+        int32_t x{ 0 }, y{ 0 };   // Steps
+
+        void onG1Received(Coordinate cx, Coordinate cy, uint8_t relative) {
+            int32_t const to_x = cx.toSteps(steps_per_mm) + (relative ? x : 0);
+            int32_t const to_y = cy.toSteps(steps_per_mm) + (relative ? y : 0);
+            int32_t const dx = to_x - x, dy = to_y - y;
+
+            (*drain)(false); // Make room, the same way the executor would block on the step interrupt
+            if (planner->push(dx, dy) && (dx != 0 || dy != 0)) {
+                uint32_t const major = std::max(std::abs(dx), std::abs(dy));
+                *baseline_ticks += static_cast<uint64_t>(major) * (config->tick_hz / config->min_speed);
+                ++*segments;
+            }
+            x = to_x;
+            y = to_y;
+        }
+    } mover{ &planner, &config, &run, steps_per_mm, &baseline_ticks, &segments };
+
+    GCodeParser parser(&mover);
+
+    char const* line;
+    size_t length;
+    for (auto lines = input.lines(); lines.next(line, length);) {
+        parser.parse(line, length);
+        run(false);
+    }
+    run(true);
+
+    if (x_steps != mover.x || y_steps != mover.y) {
+        std::cerr << "Planner ended at " << x_steps << ',' << y_steps << " instead of " << mover.x << ',' << mover.y << '\n';
+        return 1;
+    }
+
+    double const planned = static_cast<double>(ticks) / config.tick_hz;
+    double const baseline = static_cast<double>(baseline_ticks) / config.tick_hz;
+
+    std::cout << segments << " segments, " << step_events << " step events\n"
+            << "constant " << config.min_speed << " steps/s: " << baseline << " s\n"
+            << "planned:  " << planned << " s (" << (planned > 0 ? baseline / planned : 0) << "x faster)\n";
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <string>
+
+#include "Telemetry.h"
+#include "LogFile.h"
+
+/*
+ * Host tool: splits a capture of the plotter's serial output into text replies and telemetry frames.
+ * Samples go to stdout as CSV, with the time unwrapped, for plotting the measured position against the commanded target.
+ * position, planner_depth and step_rate are left empty in samples from a firmware that drives no steppers.
+ * Text goes to stderr, and a summary of lost and corrupt frames at the end.
+ * Usage: telemetry <capture.bin>
+ */
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <capture.bin>\n";
+        return 1;
+    }
+
+    LogFile capture(argv[1]);
+    if (!capture.is_open()) {
+        std::cerr << "Could not open " << argv[1] << '\n';
+        return 1;
+    }
+
+    std::string text;
+    size_t samples{ 0 }, lost{ 0 };
+    uint64_t time{ 0 };
+    bool first{ true };
+    uint8_t last_sequence{ 0 };
+    uint16_t last_time{ 0 };
+
+    auto on_text = [&text](char c) { text += c; };
+    auto on_sample = [&](Telemetry::Sample const& sample, uint8_t const sequence) {
+        if (!first) {
+            lost += static_cast<uint8_t>(sequence - last_sequence - 1);
+            time += static_cast<uint16_t>(sample.time - last_time);
+        }
+        first = false;
+        last_sequence = sequence;
+        last_time = sample.time;
+        ++samples;
+
+        std::cout << time << ',' << sample.target_x << ',' << sample.target_y << ',';
+        if (sample.flags & Telemetry::Sample::Measured)
+            std::cout << sample.position_x << ',' << sample.position_y << ',' << +sample.queue_depth << ',' << +sample.planner_depth
+                    << ',' << sample.step_rate << '\n';
+        else
+            std::cout << ",," << +sample.queue_depth << ",,\n";
+    };
+
+    Telemetry::Decoder decoder(on_text, on_sample);
+
+    std::cout << "time_ms,target_x,target_y,position_x,position_y,queue_depth,planner_depth,step_rate\n";
+    for (size_t i = 0; i < capture.size(); ++i)
+        decoder.feed(static_cast<uint8_t>(capture.data()[i]));
+
+    std::cerr << text << '\n' << samples << " samples, " << lost << " lost, " << decoder.corruptFrames() << " corrupt\n";
+}